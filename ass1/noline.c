@@ -10,19 +10,58 @@
  * 'naughts and crosses' but differs in that the first player to form a
  * line of three markers loses. The board size can be set using the dim
  * arg (must be an odd integer greater than three), and the player types
- * can be set (0 - human, 1 - AI from top left, 2 - AI from bottom right).
+ * can be set (0 - human, 1 - AI from top left, 2 - AI from bottom right,
+ * 3 - external engine).
  * It is also possible to get input from a files for human players (Oin, Xin)
  * and write output to files regardless of player type.
  * 
  * '-' is the standard io file (i.e. if '-' is specified for Oin, it will
  * read from stdin).
  *
+ * Player type 3 is an external engine, given with -O engine or -X engine.
+ * The engine is started once per game and spoken to over a pair of pipes
+ * with a line based protocol (similar to UCI):
+ *
+ *     noline -> engine: "noline dim"           engine -> noline: "ready"
+ *     noline -> engine: "position cells"
+ *     noline -> engine: "go cursor movetime"   engine -> noline: "move x y"
+ *     noline -> engine: "quit"
+ *
+ * cells is the grid in row order (dim*dim characters of '.', 'O' or 'X'),
+ * and movetime is the per move time limit in milliseconds set by
+ * -t movetime (0 for no limit), which also bounds the wait for "ready".
+ * An engine that does not answer in time loses on time, an engine that
+ * closes its pipe loses due to EOF and an engine that gives
+ * MAX_BAD_REPLIES invalid moves in a row forfeits.
+ *
+ * -e turns on early termination: a count of the cells each player can still
+ * take without forming a line is kept up to date after every move, and the
+ * side to move loses as soon as it has no such cell left.
+ *
+ * noline --playout games dim ... plays the given number of random games
+ * for each dim, split across one thread per core, and reports the games 
+ * played per second and how the games ended. noline must be linked with
+ * -pthread, which the makefile does.
+ *
  * All commenting is designed to be compatible with Doxygen.
  */
 
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/** The number of invalid moves in a row after which an engine forfeits */
+#define MAX_BAD_REPLIES 10
 
 /** \struct PlayerStruct
  *  \brief Creates a structure that manages each players 
@@ -31,13 +70,34 @@
 typedef struct {
     char cursor;    /**< The players cursor, X or O  */
     int  numMoves;  /**< The number of moves the player has attempted  */
-    int  type;      /**< The type of player, 0 human, 1 AI1, 2 AI2 */
+    int  type;      /**< The type of player, 0 human, 1 AI1, 2 AI2, 3 engine */
     int usein;      /**< 0 if the player is using stdin, else 1 */
     int endoffile;  /**< Stores 1 if end of file has been reached, else 0 */
+    int timedout;   /**< Stores 1 if the engine ran out of time, else 0 */
+    int moveTime;   /**< The engine's time limit per move in ms, 0 none */
+    int badReplies; /**< The engine's invalid moves in a row */
     FILE *in;       /**< Stores the input file for the player */
     FILE *out;      /**< Stores the output file for the player */
+    char *engine;   /**< The engine command for a type 3 player */
+    pid_t enginePid;    /**< The pid of the engine, 0 if not running */
+    FILE *toEngine;     /**< Pipe that sends commands to the engine */
+    int fromEngine;     /**< File descriptor the engine replies on */
+    char *safe;     /**< dim*dim flags, 1 if a cell is safe, NULL if unused */
+    int numSafe;    /**< The number of cells flagged in safe */
 } PlayerStruct;
 
+/** \struct PlayoutStruct
+ *  \brief Creates a structure that holds the work and results of one
+ *          random playout thread
+ */
+typedef struct {
+    int dim;        /**< The grid dimension to play on */
+    long games;     /**< The number of games to play */
+    unsigned int seed;  /**< The thread's xorshift state */
+    long results[3];    /**< Games that O lost, X lost and were drawn */
+    pthread_t thread;   /**< The thread ID */
+} PlayoutStruct;
+
 /**
  * Function prototypes 
  * Detailed usage instruction can be found in the comments within 
@@ -55,9 +115,15 @@ int     check_loser     (int dim, char **grid, char playerCursor,
 int     check_end       (PlayerStruct *player, int curPlayer, int numMoves,
         int dim, char **grid, int *validCoords);
 
+/** Closes the players i/o files */
+void    close_players   (PlayerStruct *player);
+
 /** Creates the playing grid */
 char  **create_grid     (int dim);
 
+/** Sets up the safe cell counts for early termination */
+void    create_safe     (PlayerStruct *player, int dim);
+
 /** Sets up the players structures */
 void    create_players  (PlayerStruct *player);
     
@@ -69,9 +135,16 @@ void    draw_grid       (FILE *out, int dim, char **grid);
     
 /** Gives the end game message */
 void    end_game        (PlayerStruct *player, int curPlayer, char *message);
+
+/** Asks an external engine for its move */
+char   *engine_move     (PlayerStruct *player, int dim, char **grid);
+
+/** Reads a line from an external engine within a time limit */
+int     engine_read_line(PlayerStruct *player, char *line, int size,
+        int timeout);
     
 /** Gets the player input */
-char   *get_input       (PlayerStruct *player, int dim);
+char   *get_input       (PlayerStruct *player, int dim, char **grid);
 
 /** Runs the main loop code */
 void    main_loop (int curPlayer, int numMoves, int dim, 
@@ -80,8 +153,28 @@ void    main_loop (int curPlayer, int numMoves, int dim,
  /** Makes a move on the grid */
 char  **make_move        (char **grid, char playerCursor, int x, int y);
    
+/** Reads the options given before dim */
+int     parse_options    (int *argc, char ***argv, PlayerStruct *player,
+        int *early);
+
+/** Plays random games to completion */
+void   *play_out_thread  (void *arg);
+
+/** Runs the random playout benchmark */
+int     play_outs        (int argc, char **argv);
+
 /** Prints a line of a character */ 
 void    print_line       (FILE *out, int length, char input);
+
+/** Starts the external engine for a player */
+int     start_engine     (PlayerStruct *player, int dim);
+
+/** Tells an external engine to quit and reaps it */
+void    stop_engine      (PlayerStruct *player);
+
+/** Updates the safe cell counts around a move */
+void    update_safe      (PlayerStruct *player, int dim, char **grid, 
+        int x, int y);
        
 /** Validates the arguments given to the program */
 int     validate_args    (int argc, char** argv, int *dim, 
@@ -96,25 +189,50 @@ int    *validate_input   (char *playerInput, int dim, char **grid);
 /** Validates the player arguments */
 int     validate_players (int argc, char **argv, PlayerStruct *player);
 
+/** Gets the next number from an xorshift generator */
+unsigned int xorshift (unsigned int *state);
+
 int main(int argc, char **argv) {
     
     int dim = 0;            /* The grid dimension */
     int numMoves = 0;       /* The total move counter */
     int validArgs;          /* Stores the return of validArgs */
+    int early = 0;          /* 1 if early termination is turned on */
     int curPlayer = 0;      /* The current player, 0 for O, 1 for X */
     char **grid;            /* The grid that players see */
     PlayerStruct player[2]; /* The structures that store the players vars */
 
+    if (argc > 1 && strcmp(argv[1], "--playout") == 0) {
+        return play_outs(argc, argv);
+    }
+
     create_players(player);
 
+    if (parse_options(&argc, &argv, player, &early) > 0) {
+        argc = 0;
+    }
+
     validArgs = validate_args(argc, argv, &dim, player);
 
     if (validArgs > 0 ) {
         return validArgs;
     }
 
+    if (start_engine(&player[0], dim) > 0 
+            || start_engine(&player[1], dim) > 0) {
+        fprintf(stderr, "Unable to start engine.\n");
+        stop_engine(&player[0]);
+        stop_engine(&player[1]);
+        close_players(player);
+        return 5;
+    }
+
     grid = create_grid(dim);
 
+    if (early == 1) {
+        create_safe(player, dim);
+    }
+
     draw_grid(player[curPlayer].out, dim, grid);
 
     main_loop(curPlayer, numMoves, dim, player, grid);
@@ -139,7 +257,8 @@ int check_board_full (int dim, int numMoves) {
 /**\details
  * Check if the game has been lost because end of file has been reached, 
  * if the current player has formed three markers in a row or if the
- * current player has filled the board.
+ * current player has filled the board. If safe cells are being counted,
+ * the game is also lost by the next player if they have none left.
  *
  * \param player (array containing two PlayerStruct values)
  * \param curPlayer (integer (0 or 1) that designates the current player)
@@ -159,7 +278,14 @@ int check_end (PlayerStruct *player, int curPlayer, int numMoves,
             draw_grid(player[curPlayer].out, dim, grid);
         }
 
-        end_game(player, curPlayer, "Player %c loses due to EOF.\n");
+        if (player[curPlayer].timedout == 1) {
+            end_game(player, curPlayer, "Player %c loses on time.\n");
+        } else if (player[curPlayer].badReplies >= MAX_BAD_REPLIES) {
+            end_game(player, curPlayer, 
+                    "Player %c forfeits after too many invalid moves.\n");
+        } else {
+            end_game(player, curPlayer, "Player %c loses due to EOF.\n");
+        }
         return 1;
 
     } else if (check_loser(dim, grid, player[curPlayer].cursor, 
@@ -170,6 +296,12 @@ int check_end (PlayerStruct *player, int curPlayer, int numMoves,
     } else if (check_board_full(dim, numMoves) == 1) {
         end_game(player, curPlayer, "The game is a draw.\n");
         return 1;
+
+    } else if (player[1 - curPlayer].safe != NULL 
+            && player[1 - curPlayer].numSafe == 0) {
+        end_game(player, 1 - curPlayer, 
+                "Player %c loses as every move loses.\n");
+        return 1;
     }
 
     return 0;
@@ -197,14 +329,14 @@ int check_loser (int dim, char **grid, char playerCursor, int x, int y) {
     /* If valid, check to 2 moves to the left of the cursor */
     if ((x > 1) && ((grid[x-2][y] == n && grid[x-1][y] == n)
             || (y > 1 && grid[x-2][y-2] == n && grid[x-1][y-1] == n)
-            || (y < dim-1 && grid[x-2][y+2] == n && grid[x-1][y+1] == n))) {
+            || (y < dim-2 && grid[x-2][y+2] == n && grid[x-1][y+1] == n))) {
         return 0;
     }
     
     /* If valid, check to 2 moves to the right of the cursor */
     if ((x < dim-2) && ((grid[x+2][y] == n && grid[x+1][y] == n)
             || (y > 1 && grid[x+2][y-2] == n && grid[x+1][y-1] == n)
-            || (y < dim-1 && grid[x+2][y+2] == n && grid[x+1][y+1] == n))) {
+            || (y < dim-2 && grid[x+2][y+2] == n && grid[x+1][y+1] == n))) {
         return 0;
     }
 
@@ -253,6 +385,24 @@ char **create_grid (int dim) {
     return grid;
 }
 
+/**\details
+ * Allocates the safe cell flags for both players. On an empty board every
+ * cell is safe.
+ *
+ * \param player (array containing two PlayerStruct values)
+ * \param dim (positive integer)
+ */
+void create_safe (PlayerStruct *player, int dim) {
+
+    int i;
+
+    for (i = 0; i<2; ++i) {
+        player[i].safe = (char *) malloc(sizeof(char)*dim*dim);
+        memset(player[i].safe, 1, dim*dim);
+        player[i].numSafe = dim*dim;
+    }
+}
+
 /**\details
  * Writes the relevant initial values to the players array
  *
@@ -269,14 +419,24 @@ void create_players (PlayerStruct *player) {
         player[i].type = 0;
         player[i].usein = 0;
         player[i].endoffile = 0;
+        player[i].timedout = 0;
+        player[i].moveTime = 0;
+        player[i].badReplies = 0;
         player[i].in = stdin;
         player[i].out = stdout;
+        player[i].engine = NULL;
+        player[i].enginePid = 0;
+        player[i].toEngine = NULL;
+        player[i].fromEngine = -1;
+        player[i].safe = NULL;
+        player[i].numSafe = 0;
     }
 
 }
 
 /**\details
- * Frees the memory used by the grid and closes the players i/o files
+ * Frees the memory used by the grid, stops any engines and closes the
+ * players i/o files
  *
  * \param dim (positive integer)
  * \param grid (a dim*dim size array of chars, created with create_grid)
@@ -290,10 +450,32 @@ void destroy_grid (int dim, char **grid, PlayerStruct *player) {
     }
     free(grid);
 
-    fclose(player[0].in);
-    fclose(player[0].out);
-    fclose(player[1].in);
-    fclose(player[1].out);
+    stop_engine(&player[0]);
+    stop_engine(&player[1]);
+
+    free(player[0].safe);
+    free(player[1].safe);
+
+    close_players(player);
+}
+
+/**\details
+ * Closes the input and output files of both players, leaving stdin and
+ * stdout open. Files that failed to open (NULL) are skipped.
+ *
+ * \param player (array containing two PlayerStruct values)
+ */
+void close_players (PlayerStruct *player) {
+
+    int i;
+    for (i = 0; i<2; ++i) {
+        if (player[i].in != NULL && player[i].in != stdin) {
+            fclose(player[i].in);
+        }
+        if (player[i].out != NULL && player[i].out != stdout) {
+            fclose(player[i].out);
+        }
+    }
 }
 
 /**\details
@@ -337,6 +519,111 @@ void end_game (PlayerStruct *player, int curPlayer, char *message) {
     }
 }
 
+/**\details
+ * Sends the current position to the engine and asks it to move, then waits
+ * up to moveTime milliseconds for a reply of the form "move x y". If the
+ * engine has closed its pipe the player has reached end of file, and if it
+ * does not reply in time it has timed out (and reached end of file).
+ *
+ * \param player (the PlayerStruct of a type 3 player)
+ * \param dim (positive integer)
+ * \param grid (a dim*dim size array of chars, created with create_grid)
+ *
+ * \return playerInput (A single line string of the form "x y")
+ */
+char *engine_move (PlayerStruct *player, int dim, char **grid) {
+
+    static char playerInput[82];
+    char line[82];
+    int i, j, x, y;
+
+    fprintf(player->toEngine, "position ");
+    for (i = 0; i<dim; ++i) {
+        for (j = 0; j<dim; ++j) {
+            fputc(grid[i][j], player->toEngine);
+        }
+    }
+    fprintf(player->toEngine, "\ngo %c %d\n", player->cursor, 
+            player->moveTime);
+
+    if (fflush(player->toEngine) != 0) {
+        player->endoffile = 1;
+        return "";
+    }
+
+    switch (engine_read_line(player, line, 82, player->moveTime)) {
+        case -1:
+            player->endoffile = 1;
+            return "";
+        case -2:
+            player->timedout = 1;
+            player->endoffile = 1;
+            return "";
+    }
+
+    /* Anything but a move is passed on as an invalid move */
+    if (sscanf(line, "move %d %d", &x, &y) != 2) {
+        return "";
+    }
+
+    sprintf(playerInput, "%d %d", x, y);
+    return playerInput;
+}
+
+/**\details
+ * Reads a single line from the engine one character at a time, waiting 
+ * with poll() for at most timeout milliseconds in total (no limit if 
+ * timeout is 0). The newline is removed and lines longer than size are cut
+ * short.
+ *
+ * \param player (the PlayerStruct of a type 3 player)
+ * \param line (buffer of length size to read the line into)
+ * \param size (the size of line)
+ * \param timeout (time limit in milliseconds, 0 for no limit)
+ *
+ * \return 0 if a line was read
+ * \return -1 if the engine closed its pipe
+ * \return -2 if the time limit was reached
+ */
+int engine_read_line (PlayerStruct *player, char *line, int size, 
+        int timeout) {
+
+    struct pollfd pfd;
+    struct timeval start, now;
+    int count = 0, wait = -1;
+    char c;
+
+    pfd.fd = player->fromEngine;
+    pfd.events = POLLIN;
+    gettimeofday(&start, NULL);
+
+    while (1) {
+        if (timeout > 0) {
+            gettimeofday(&now, NULL);
+            wait = timeout - ((now.tv_sec - start.tv_sec) * 1000 
+                    + (now.tv_usec - start.tv_usec) / 1000);
+            if (wait <= 0) {
+                return -2;
+            }
+        }
+
+        if (poll(&pfd, 1, wait) == 0) {
+            return -2;
+        }
+
+        if (read(player->fromEngine, &c, 1) != 1) {
+            return -1;
+        }
+
+        if (c == '\n') {
+            line[count] = '\0';
+            return 0;
+        } else if (count < size - 1) {
+            line[count++] = c;
+        }
+    }
+}
+
 /**\details
  * If the player is human, check for end of file. If the file has not ended,
  * Get 81 characters of player input, and end the string at the newline, and
@@ -349,16 +636,23 @@ void end_game (PlayerStruct *player, int curPlayer, char *message) {
  * type 1: [i/dim, i%dim]
  * type 2: [dim-(1+i/dim), dim-(1+i%dim)]
  *
+ * If player type is 3, the move is asked of the external engine.
+ *
  * \param player (array containing two PlayerStruct values)
  * \param dim (positive integer)
+ * \param grid (a dim*dim size array of chars, created with create_grid)
  *
  * \return playerInput (A single line string with a max strlen of 81)
  */
-char *get_input (PlayerStruct *player, int dim) {
+char *get_input (PlayerStruct *player, int dim, char **grid) {
 
     static char playerInput[82];
     int i;
 
+    if (player->type == 3) {
+        return engine_move(player, dim, grid);
+    }
+
     if (player->type == 0) {
         if (feof(player->in) != 0) {
             player->endoffile = 1;
@@ -422,9 +716,15 @@ void main_loop (int curPlayer, int numMoves, int dim,
 
         curPlayer = numMoves%2;
 
-        playerInput = get_input(&player[curPlayer], dim);
+        playerInput = get_input(&player[curPlayer], dim, grid);
 
         validCoords = validate_input(playerInput, dim, grid);
+
+        /* An engine that keeps giving invalid moves forfeits, like EOF */
+        if (validCoords[0] == -1 && player[curPlayer].type == 3
+                && ++player[curPlayer].badReplies >= MAX_BAD_REPLIES) {
+            player[curPlayer].endoffile = 1;
+        }
         
         if (player[curPlayer].endoffile == 0) {
 
@@ -432,7 +732,10 @@ void main_loop (int curPlayer, int numMoves, int dim,
             if (validCoords[0] == -1) {
                 player[curPlayer].numMoves++;
                 continue;
-            } else if (player[curPlayer].type > 0) {
+            }
+
+            player[curPlayer].badReplies = 0;
+            if (player[curPlayer].type > 0) {
                 fprintf(player[curPlayer].out, "%c> %d %d\n", 
                         player[curPlayer].cursor, validCoords[1], 
                         validCoords[2]);
@@ -440,6 +743,11 @@ void main_loop (int curPlayer, int numMoves, int dim,
 
             grid = make_move(grid, player[curPlayer].cursor, 
                     validCoords[1], validCoords[2]);
+
+            if (player[0].safe != NULL) {
+                update_safe(player, dim, grid, validCoords[1], 
+                        validCoords[2]);
+            }
         }
 
         draw_grid(player[(curPlayer == 1 ? 0 : 1)].out, dim, grid);
@@ -469,6 +777,201 @@ char **make_move (char** grid, char playerCursor, int x, int y) {
     return grid;
 }
 
+/**\details
+ * Reads the options given before dim and removes them from argc and argv.
+ * -O and -X set the engine command for player O and X, -t sets the
+ * time limit per move (in milliseconds) for engines and -e turns on early
+ * termination.
+ *
+ * \param argc (pointer to the number of arguments, value is modified)
+ * \param argv (pointer to the arguments, value is modified)
+ * \param player (array containing two PlayerStruct values)
+ * \param early (set to 1 if -e is given, value is modified)
+ *
+ * \return 1 if an option is invalid
+ * \return 0 otherwise
+ */
+int parse_options (int *argc, char ***argv, PlayerStruct *player, 
+        int *early) {
+
+    char **args = *argv;
+    int moveTime, used;
+    char c;
+
+    while (*argc > 2 && args[1][0] == '-' && args[1][1] != '\0'
+            && args[1][2] == '\0') {
+        used = 2;
+
+        switch (args[1][1]) {
+            case 'e':
+                *early = 1;
+                used = 1;
+                break;
+            case 'O':
+                player[0].engine = args[2];
+                break;
+            case 'X':
+                player[1].engine = args[2];
+                break;
+            case 't':
+                if (sscanf(args[2], "%d%c", &moveTime, &c) != 1 
+                        || moveTime < 0) {
+                    return 1;
+                }
+                player[0].moveTime = moveTime;
+                player[1].moveTime = moveTime;
+                break;
+            default:
+                return 1;
+        }
+
+        /* Keep the program name in place and drop the option */
+        args[used] = args[0];
+        args += used;
+        *argc -= used;
+    }
+
+    *argv = args;
+    return 0;
+}
+
+/**\details
+ * Plays arg->games random games on a dim*dim grid. Each game keeps a list
+ * of the free cells, and each move swaps a random free cell out of the 
+ * list, so picking a legal move is O(1). The game ends when check_loser 
+ * fires on the move just played or the list is empty, and the result is
+ * added to arg->results.
+ *
+ * \param arg (pointer to a PlayoutStruct, results are modified)
+ *
+ * \return NULL
+ */
+void *play_out_thread (void *arg) {
+
+    PlayoutStruct *work = (PlayoutStruct *) arg;
+    int dim = work->dim;
+    int *cells = (int *) malloc(sizeof(int)*dim*dim);
+    char **grid = create_grid(dim);
+    char cursor[2] = {'O', 'X'};
+    int numFree, pick, cell, curPlayer, i;
+    long game;
+
+    for (game = 0; game < work->games; ++game) {
+
+        for (i = 0; i<dim*dim; ++i) {
+            grid[i/dim][i%dim] = '.';
+            cells[i] = i;
+        }
+
+        numFree = dim*dim;
+        curPlayer = 0;
+
+        while (1) {
+            pick = xorshift(&work->seed) % numFree;
+            cell = cells[pick];
+            cells[pick] = cells[--numFree];
+
+            grid[cell/dim][cell%dim] = cursor[curPlayer];
+
+            if (check_loser(dim, grid, cursor[curPlayer], 
+                    cell/dim, cell%dim) == 0) {
+                work->results[curPlayer]++;
+                break;
+            } else if (numFree == 0) {
+                work->results[2]++;
+                break;
+            }
+
+            curPlayer = 1 - curPlayer;
+        }
+    }
+
+    for (i = 0; i<dim; ++i) {
+        free(grid[i]);
+    }
+    free(grid);
+    free(cells);
+
+    return NULL;
+}
+
+/**\details
+ * Handles noline --playout games dim ...
+ *
+ * For each dim, split the games across one thread per online core, each 
+ * with its own xorshift stream, and wait for them to finish. Print the 
+ * games per second and the share of games that O lost, X lost and drew.
+ *
+ * \param argc (the number of arguments given to the program at runtime)
+ * \param argv (an array of arguments given to the program of length argc)
+ *
+ * \return 1 if incorrect arguments given
+ * \return 0 otherwise
+ */
+int play_outs (int argc, char **argv) {
+
+    PlayoutStruct *work;
+    struct timeval start, end;
+    long games, results[3];
+    int numThreads, dim, i, j;
+    double seconds;
+    char c;
+
+    if (argc < 4 || sscanf(argv[2], "%ld%c", &games, &c) != 1 
+            || games < 1) {
+        fprintf(stderr, "Usage: noline --playout games dim ...\n");
+        return 1;
+    }
+
+    numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    work = (PlayoutStruct *) malloc(sizeof(PlayoutStruct)*numThreads);
+
+    for (i = 3; i<argc; ++i) {
+        if (sscanf(argv[i], "%d%c", &dim, &c) != 1 || dim < 3 
+                || dim%2 == 0) {
+            fprintf(stderr, "Invalid board dimension.\n");
+            free(work);
+            return 2;
+        }
+
+        gettimeofday(&start, NULL);
+
+        for (j = 0; j<numThreads; ++j) {
+            work[j].dim = dim;
+            work[j].games = games/numThreads + (j < games%numThreads);
+            work[j].seed = ((2654435769u * (j + 1)) ^ start.tv_usec) | 1;
+            work[j].results[0] = 0;
+            work[j].results[1] = 0;
+            work[j].results[2] = 0;
+            pthread_create(&work[j].thread, NULL, play_out_thread, &work[j]);
+        }
+
+        results[0] = results[1] = results[2] = 0;
+        for (j = 0; j<numThreads; ++j) {
+            pthread_join(work[j].thread, NULL);
+            results[0] += work[j].results[0];
+            results[1] += work[j].results[1];
+            results[2] += work[j].results[2];
+        }
+
+        gettimeofday(&end, NULL);
+        seconds = (end.tv_sec - start.tv_sec) 
+                + (end.tv_usec - start.tv_usec) / 1e6;
+
+        printf("dim %d: %ld games in %.3fs (%.0f games/s) ", dim, games,
+                seconds, games / (seconds > 0 ? seconds : 1e-6));
+        printf("O loses %.2f%% X loses %.2f%% draw %.2f%%\n", 
+                100.0 * results[0] / games, 100.0 * results[1] / games,
+                100.0 * results[2] / games);
+    }
+
+    free(work);
+    return 0;
+}
+
 /**\details
  * Prints a line of a single characters 'length' long  
  *
@@ -484,6 +987,104 @@ void print_line (FILE *out, int length, char input) {
     fprintf(out, "\n");
 }
 
+/**\details
+ * If the player is an engine, create a pair of pipes and fork. The child
+ * replaces its stdin and stdout with the pipes and execs the engine, and 
+ * the parent sends "noline dim" and waits up to the move time for the
+ * engine to reply "ready" (an engine that does not is killed). The parent's
+ * ends of the pipes are closed on exec, so the other player's engine does
+ * not hold them open. The engine is left running for the rest of the game.
+ *
+ * \param player (the PlayerStruct to start an engine for)
+ * \param dim (positive integer)
+ *
+ * \return 1 if the engine could not be started
+ * \return 0 otherwise
+ */
+int start_engine (PlayerStruct *player, int dim) {
+
+    int toEngine[2], fromEngine[2];
+    char line[82];
+
+    if (player->type != 3) {
+        return 0;
+    }
+
+    /* A dead engine should lose the game rather than kill noline */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* noline's ends must not be inherited by the other player's engine,
+     * or this engine would never see EOF when noline closes them */
+    if (pipe(toEngine) || pipe(fromEngine)
+            || fcntl(toEngine[1], F_SETFD, FD_CLOEXEC) == -1
+            || fcntl(fromEngine[0], F_SETFD, FD_CLOEXEC) == -1) {
+        return 1;
+    }
+
+    switch (player->enginePid = fork()) {
+        case -1:
+            player->enginePid = 0;
+            return 1;
+        case 0:
+            if (dup2(toEngine[0], STDIN_FILENO) == -1 
+                    || dup2(fromEngine[1], STDOUT_FILENO) == -1) {
+                exit(1);
+            }
+            close(toEngine[0]);
+            close(toEngine[1]);
+            close(fromEngine[0]);
+            close(fromEngine[1]);
+            execlp(player->engine, player->engine, (char *) NULL);
+            exit(1);
+    }
+
+    close(toEngine[0]);
+    close(fromEngine[1]);
+    player->toEngine = fdopen(toEngine[1], "w");
+    player->fromEngine = fromEngine[0];
+
+    /* An engine that is not ready within the move time is killed */
+    fprintf(player->toEngine, "noline %d\n", dim);
+    if (fflush(player->toEngine) != 0) {
+        return 1;
+    }
+    switch (engine_read_line(player, line, 82, player->moveTime)) {
+        case -2:
+            player->timedout = 1;
+            return 1;
+        case -1:
+            return 1;
+    }
+    if (strcmp(line, "ready") != 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**\details
+ * If the player's engine is running, tell it to quit, close the pipes and 
+ * wait for it to exit. An engine that ran out of time is killed instead.
+ *
+ * \param player (the PlayerStruct to stop the engine of)
+ */
+void stop_engine (PlayerStruct *player) {
+
+    if (player->enginePid == 0) {
+        return;
+    }
+
+    if (player->timedout == 1) {
+        kill(player->enginePid, SIGTERM);
+    }
+
+    fprintf(player->toEngine, "quit\n");
+    fclose(player->toEngine);
+    close(player->fromEngine);
+    waitpid(player->enginePid, NULL, 0);
+    player->enginePid = 0;
+}
+
 /**\details
  * Check that the right number of arguments have been given.
  * If they have, set the dim variable and check if it is a postive
@@ -512,7 +1113,8 @@ int validate_args (int argc, char **argv, int *dim, PlayerStruct *player) {
     /* Check for correct amount of args */
     if (argc != 2 && argc != 3 && argc != 4 && argc != 8){
 
-        fprintf(stderr, "Usage: noline dim [playerXtype [playerOtype ");
+        fprintf(stderr, "Usage: noline [-e] [-O engine] [-X engine] ");
+        fprintf(stderr, "[-t movetime] dim [playerXtype [playerOtype ");
         fprintf(stderr, "[Oin Oout Xin Xout]]]\n");
 
         return 1;
@@ -574,12 +1176,43 @@ int validate_files (char **argv, PlayerStruct *player) {
     if (player[0].in == NULL || player[0].out == NULL 
             || player[1].in == NULL || player[1].out == NULL){
         fprintf(stderr, "Invalid files.\n");
+        close_players(player);
         return 4;
     }
 
     return 0;
 }
 
+/**\details
+ * Re-checks every cell within two squares of [x, y] (the only cells whose
+ * lines pass through [x, y]) for both players. A cell is safe for a player
+ * if it is empty and check_loser says taking it would not form a line.
+ * The counts of safe cells are kept in step with the flags.
+ *
+ * \param player (array containing two PlayerStruct values)
+ * \param dim (positive integer)
+ * \param grid (a dim*dim size array of chars, created with create_grid)
+ * \param x (positive integer < dim)
+ * \param y (positive integer < dim)
+ */
+void update_safe (PlayerStruct *player, int dim, char **grid, int x, int y) {
+
+    int i, j, p;
+    char safe;
+
+    for (i = (x > 1 ? x-2 : 0); i <= x+2 && i < dim; ++i) {
+        for (j = (y > 1 ? y-2 : 0); j <= y+2 && j < dim; ++j) {
+            for (p = 0; p<2; ++p) {
+                safe = (grid[i][j] == '.' 
+                        && check_loser(dim, grid, player[p].cursor, i, j));
+
+                player[p].numSafe += safe - player[p].safe[i*dim + j];
+                player[p].safe[i*dim + j] = safe;
+            }
+        }
+    }
+}
+
 /**\details
  * Check if the move is within the expected length, if so attempt
  * to extract two integers using sscanf("%d %d",...).
@@ -632,6 +1265,7 @@ int *validate_input (char *playerInput, int dim, char **grid) {
 /**\details
  * Check both argument 2 and argument 3 are both single digit integers.
  * If so, set the corresponding player type, otherwise give an error.
+ * An engine player (type 3) must have had its engine given with -O or -X.
  *
  * \param argc (the number of arguments given to the program at runtime)
  * \param argv (an array of arguments given to the program of length argc)
@@ -646,7 +1280,8 @@ int validate_players (int argc, char **argv, PlayerStruct *player) {
 
     for (i = 2; i<4; ++i) {
         if (argc > i) {
-            if (strlen(argv[i]) == 1 && argv[i][0] > 47 && argv[i][0] < 51) {
+            if (strlen(argv[i]) == 1 && argv[i][0] > 47 && argv[i][0] < 52
+                    && (argv[i][0] != '3' || player[(i+1)%2].engine)) {
                 player[(i+1)%2].type = (int) atoi(argv[i]);
             } else {
                 fprintf(stderr, "Invalid player type.\n");
@@ -656,4 +1291,20 @@ int validate_players (int argc, char **argv, PlayerStruct *player) {
     }
 
     return 0;
+}
+
+/**\details
+ * Advances a 32 bit xorshift generator and returns its next value. Each 
+ * thread keeps its own state, so no locking is needed.
+ *
+ * \param state (the generator state, must not be 0, value is modified)
+ *
+ * \return the next pseudo random number
+ */
+unsigned int xorshift (unsigned int *state) {
+
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
 }
\ No newline at end of file
@@ -0,0 +1,202 @@
+/**
+ * \file   batch.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the batch mode of thresher
+ *
+ * \details
+ *
+ * Contains the functions that give many files to one compiler run and
+ * split its output back into a table for each file, so the compiler is
+ * only started once for each batch.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <ctype.h>
+
+#include "batch.h"
+
+/**\details
+ * Finds the file of the batch a line is about
+ *
+ * \param ts (ThresherStruct with the batch set)
+ * \param line (the line)
+ *
+ * \return the index of the file in ts->batchFiles
+ * \return -1 if the line does not start with a file followed by ':'
+ */
+static int batch_file(ThresherStruct *ts, const char *line) {
+
+    for (int i = 0; i < ts->batchSize; ++i) {
+        size_t len = strlen(ts->batchFiles[i]);
+
+        if (!strncmp(line, ts->batchFiles[i], len) && line[len] == ':') {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**\details
+ * Checks if a line about a file is an error, meaning the diagnostic after
+ * its line and column numbers is BATCH_ERROR (or "fatal " BATCH_ERROR). A
+ * line only mentioning "error" in its message is not.
+ *
+ * \param rest (the line after the file name, starting at its ':')
+ *
+ * \return 1 if the line is an error, else 0
+ */
+static int batch_error(const char *rest) {
+
+    // Skip the line and column numbers
+    while (*rest == ':' || isdigit((unsigned char) *rest)) {
+        rest++;
+    }
+    while (*rest == ' ') {
+        rest++;
+    }
+
+    if (!strncmp(rest, "fatal ", 6)) {
+        rest += 6;
+    }
+
+    return !strncmp(rest, BATCH_ERROR, strlen(BATCH_ERROR));
+}
+
+/**\details
+ * Prints the start of a file's block: the dashes, and the compiler's lines
+ * about the file if show is enabled
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param shown (the compiler's lines about the file)
+ */
+static void print_start(ThresherStruct *ts, Buffer *shown) {
+
+    if (outputFormat != FORMAT_TEXT) {
+        return;
+    }
+
+    printf("----\n");
+    if (ts->show) {
+        fwrite(shown->data, 1, shown->len, stdout);
+        printf("----\n");
+    }
+}
+
+/**\details
+ * Divides a time evenly into parts
+ *
+ * \param time (the time to divide, value is modified)
+ * \param parts (the number of parts)
+ */
+static void split_time(struct timeval *time, int parts) {
+
+    long long micros = (long long) time->tv_sec * 1000000 + time->tv_usec;
+
+    micros /= parts;
+    time->tv_sec = micros / 1000000;
+    time->tv_usec = micros % 1000000;
+}
+
+void batch_run(ThresherStruct *ts, char **files, int numFiles) {
+
+    for (int i = 0; i < numFiles; ) {
+        ts->curFile = files[i];
+
+        // Types that can't compile many files at once run one at a time
+        if (!ts->build->batch) {
+            ts->batchSize = 0;
+            thresh_file(ts);
+            i++;
+            continue;
+        }
+
+        ts->batchFiles = &files[i];
+        ts->batchSize = numFiles - i < ts->batch ? numFiles - i : ts->batch;
+        thresh_file(ts);
+        i += ts->batchSize;
+    }
+
+    ts->batchSize = 0;
+}
+
+void batch_parent(ThresherStruct *ts) {
+
+    int numFiles = ts->batchSize, current = 0, anyFailed = 0, file;
+    int (*tables)[7] = (int (*)[7]) calloc(numFiles, sizeof(int[7]));
+    int *failed = (int *) calloc(numFiles, sizeof(int));
+    Buffer *shown = (Buffer *) calloc(numFiles, sizeof(Buffer));
+    ChildIO io;
+    struct rusage usage;
+    char *buffer;
+    size_t len;
+    double wall;
+    int status;
+
+    // Set up the pipes so the parent can interact with the child
+    child_io_init(ts, &io);
+
+    // Give each line to its file, lines without a file name (like the
+    // source lines under a diagnostic) go with the line before
+    while (child_io_next(&io, &buffer, &len) == 1) {
+        if ((file = batch_file(ts, buffer)) != -1) {
+            current = file;
+            if (batch_error(buffer + strlen(ts->batchFiles[file]))) {
+                failed[current] = anyFailed = 1;
+            }
+        }
+
+        if (ts->show) {
+            buffer_append(&shown[current], buffer, len);
+            buffer_append(&shown[current], "\n", 1);
+        }
+
+        tables[current][rules_parse(ts->build, &buffer, len,
+                ts->batchFiles[current], &io.replies)]++;
+    }
+    child_io_finish(&io);
+
+    // The first block has started if exec failed, as it would have for a
+    // single file
+    print_start(ts, &shown[0]);
+    parse_child_error(&io);
+
+    wait4(ts->pid, &status, 0, &usage);
+    childPid = 0;
+    token_release();
+
+    // The times are the whole batch's, so each file is given an even share
+    wall = (report_now() - ts->started) / numFiles;
+    split_time(&usage.ru_utime, numFiles);
+    split_time(&usage.ru_stime, numFiles);
+
+    // Work out each file's status as well as the output allows, and print
+    // the blocks in order
+    for (int i = 0; i < numFiles; ++i) {
+        tables[i][6] = (status && (failed[i] || !anyFailed)) ? status : 0;
+
+        if (i > 0) {
+            print_start(ts, &shown[i]);
+        }
+
+        ts->curFile = ts->batchFiles[i];
+        ts->started = report_now() - wall;
+        build_table(ts, tables[i], &usage);
+
+        if (outputFormat == FORMAT_TEXT) {
+            printf("----\n");
+        }
+    }
+
+    // Close the open files
+    child_io_free(&io);
+
+    for (int i = 0; i < numFiles; ++i) {
+        free(shown[i].data);
+    }
+    free(shown);
+    free(failed);
+    free(tables);
+}
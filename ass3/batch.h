@@ -0,0 +1,55 @@
+/**
+ * \file   batch.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for batch.c
+ *
+ * \details
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "thresherSupport.h"
+
+//! A line about a file with this as its kind of diagnostic (after the line
+//! and column, maybe as "fatal error:") makes the file fail when the batch
+//! exits with a non-zero status
+#define BATCH_ERROR "error:"
+
+/**\details
+ * Summarises the files, ts->batch of them to each compiler run.
+ *
+ * If the build type has no batch template, each file is run on its own as
+ * usual. Otherwise each group of files is run by thresh_file with
+ * ts->batchFiles set, and its output is split up by batch_parent.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param files (string array of the files to summarise)
+ * \param numFiles (the number of files)
+ */
+void batch_run(ThresherStruct *ts, char **files, int numFiles);
+
+/**\details
+ * Parses the output of a compiler run on many files.
+ *
+ * Read the output a line at a time. A line starting with the name of one
+ * of the files followed by ':' belongs to that file, and any other line
+ * belongs to the same file as the line before it. Parse each line under
+ * the build type's rules against its file's table.
+ *
+ * Once the compiler has been reaped, work out each file's exit status: 0 if
+ * the compiler succeeded, otherwise the compiler's status for the files
+ * with an error line, "file:line:col: error:" or "file:line: fatal error:"
+ * (see BATCH_ERROR), or for every file if none have one.
+ * Print each file's block as create_parent would have, in order, quitting
+ * after the first file with a non-zero status. Each file's record is given
+ * an even share of the batch's CPU and wall times.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ */
+void batch_parent(ThresherStruct *ts);
+
+#endif
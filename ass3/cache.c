@@ -0,0 +1,324 @@
+/**
+ * \file   cache.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the result cache used by thresher
+ *
+ * \details
+ *
+ * A file's block of output and exit status are saved on disk under a hash
+ * of everything that could change them: the file's contents, the command
+ * it is compiled with and the build type. If none of those have changed,
+ * the block is replayed without running the compiler. Each entry is a
+ * file in the cache directory holding a header line and the output.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include "cache.h"
+
+/** \struct CacheHash
+ *  \brief Two 64 bit FNV-1a hashes with different starting values, read
+ *          together as one 128 bit key
+ */
+typedef struct {
+    unsigned long long a;   /**< The first hash */
+    unsigned long long b;   /**< The second hash */
+} CacheHash;
+
+/** \struct CacheEntry
+ *  \brief The name, size and last use of an entry, used when trimming
+ */
+typedef struct {
+    char *name;             /**< The entry's file name */
+    off_t size;             /**< The size of the entry in bytes */
+    time_t used;            /**< The last time the entry was used */
+} CacheEntry;
+
+/**\details
+ * Adds bytes to a hash
+ *
+ * \param hash (the hash to add to, value is modified)
+ * \param data (the bytes to add)
+ * \param len (the number of bytes)
+ */
+static void hash_add(CacheHash *hash, const void *data, size_t len) {
+
+    const unsigned char *p = (const unsigned char *) data;
+
+    for (size_t i = 0; i < len; ++i) {
+        hash->a = (hash->a ^ p[i]) * 0x100000001b3ULL;
+        hash->b = (hash->b ^ p[i]) * 0x100000001b3ULL;
+    }
+}
+
+/**\details
+ * Adds a string, and its terminator, to a hash
+ *
+ * \param hash (the hash to add to, value is modified)
+ * \param str (the string to add, NULL is added as an empty string)
+ */
+static void hash_string(CacheHash *hash, const char *str) {
+
+    hash_add(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+/**\details
+ * Builds the path of a job's entry in the cache
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param job (the job with a key)
+ *
+ * \return the path, free with free()
+ */
+static char *entry_path(ThresherStruct *ts, JobStruct *job) {
+
+    char *path = (char *) malloc(strlen(ts->cacheDir) + CACHE_KEY_LEN + 2);
+
+    sprintf(path, "%s/%s", ts->cacheDir, job->key);
+    return path;
+}
+
+/**\details
+ * Orders cache entries from least to most recently used for qsort
+ *
+ * \param a (pointer to the first entry)
+ * \param b (pointer to the second entry)
+ *
+ * \return the order of the entries
+ */
+static int compare_used(const void *a, const void *b) {
+
+    time_t x = ((const CacheEntry *) a)->used;
+    time_t y = ((const CacheEntry *) b)->used;
+
+    return (x > y) - (x < y);
+}
+
+void cache_key(ThresherStruct *ts, JobStruct *job) {
+
+    CacheHash hash = {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL};
+    BuildType *bt = ts->build;
+    char chunk[65536];
+    ssize_t count;
+    int fd;
+
+    job->key[0] = '\0';
+
+    if ((fd = open(job->file, O_RDONLY)) == -1) {
+        return;
+    }
+
+    // Everything about the build type that could change the output
+    hash_string(&hash, bt->name);
+    for (int i = 0; bt->command[i]; ++i) {
+        hash_string(&hash, bt->command[i]);
+    }
+    hash_add(&hash, &bt->output, sizeof(int));
+    hash_add(&hash, &bt->prefix, sizeof(int));
+    hash_add(&hash, &bt->fallback, sizeof(int));
+    for (int i = 0; i < bt->numRules; ++i) {
+        hash_string(&hash, bt->rules[i].pattern);
+        hash_add(&hash, &bt->rules[i].category, sizeof(int));
+        hash_string(&hash, bt->rules[i].reply);
+    }
+    for (int i = 0; i < NUM_CATEGORIES; ++i) {
+        hash_string(&hash, bt->labels[i]);
+    }
+
+    // The command, the file's name (it is printed), whether the compiler's
+    // output is shown and the format it is printed in
+    hash_string(&hash, ts->cmd);
+    hash_string(&hash, job->file);
+    hash_add(&hash, &ts->show, sizeof(int));
+    hash_add(&hash, &outputFormat, sizeof(int));
+
+    // Whether it is run for JSON diagnostics, only to check syntax or
+    // without stopping, and how
+    hash_add(&hash, &ts->jsonDiags, sizeof(int));
+    for (int i = 0; ts->jsonDiags && bt->json && bt->json[i]; ++i) {
+        hash_string(&hash, bt->json[i]);
+    }
+    hash_add(&hash, &ts->syntaxOnly, sizeof(int));
+    for (int i = 0; ts->syntaxOnly && bt->syntax && bt->syntax[i]; ++i) {
+        hash_string(&hash, bt->syntax[i]);
+    }
+    hash_add(&hash, &ts->nonstop, sizeof(int));
+    for (int i = 0; ts->nonstop && bt->nonstop && bt->nonstop[i]; ++i) {
+        hash_string(&hash, bt->nonstop[i]);
+    }
+    hash_string(&hash, ts->nonstop ? bt->log : NULL);
+
+    // Where the compiler is stopped
+    hash_add(&hash, &ts->maxErrors, sizeof(int));
+    hash_add(&hash, &ts->timeout, sizeof(int));
+    hash_add(&hash, &ts->cpuLimit, sizeof(int));
+    hash_add(&hash, &ts->memLimit, sizeof(int));
+
+    // The contents of the file
+    while ((count = read(fd, chunk, sizeof(chunk))) > 0) {
+        hash_add(&hash, chunk, count);
+    }
+    close(fd);
+
+    if (count == -1) {
+        return;
+    }
+
+    sprintf(job->key, "%016llx%016llx", hash.a, hash.b);
+}
+
+int cache_lookup(ThresherStruct *ts, JobStruct *job) {
+
+    char *path;
+    FILE *entry;
+    size_t outLen, errLen;
+    int status;
+
+    if (!job->key[0]) {
+        return 0;
+    }
+
+    path = entry_path(ts, job);
+    entry = fopen(path, "r");
+
+    if (!entry) {
+        free(path);
+        return 0;
+    }
+
+    // The header gives the status and the length of each output
+    if (fscanf(entry, "thresher-cache %d %zu %zu\n", &status, &outLen,
+            &errLen) != 3) {
+        fclose(entry);
+        free(path);
+        return 0;
+    }
+
+    job->outBuf.len = job->errBuf.len = 0;
+    job->outBuf.size = outLen + 1;
+    job->outBuf.data = (char *) malloc(job->outBuf.size);
+    job->errBuf.size = errLen + 1;
+    job->errBuf.data = (char *) malloc(job->errBuf.size);
+
+    if (fread(job->outBuf.data, 1, outLen, entry) != outLen
+            || fread(job->errBuf.data, 1, errLen, entry) != errLen) {
+        free(job->outBuf.data);
+        free(job->errBuf.data);
+        memset(&job->outBuf, 0, sizeof(Buffer));
+        memset(&job->errBuf, 0, sizeof(Buffer));
+        fclose(entry);
+        free(path);
+        return 0;
+    }
+
+    job->outBuf.len = outLen;
+    job->errBuf.len = errLen;
+    job->status = status;
+    job->done = 1;
+
+    // Mark the entry as just used
+    utime(path, NULL);
+
+    fclose(entry);
+    free(path);
+    return 1;
+}
+
+void cache_store(ThresherStruct *ts, JobStruct *job) {
+
+    char *path, *temp;
+    FILE *entry;
+
+    // Only real results are worth keeping, not those of a worker whose
+    // compiler was stopped (ERR_STOPPED) by --max-errors or a limit
+    if (!job->key[0] || !WIFEXITED(job->status)
+            || (WEXITSTATUS(job->status) != 0
+            && WEXITSTATUS(job->status) != ERR_NONZERO)) {
+        return;
+    }
+
+    path = entry_path(ts, job);
+    temp = (char *) malloc(strlen(path) + 32);
+    sprintf(temp, "%s.%d.tmp", path, (int) getpid());
+
+    if ((entry = fopen(temp, "w"))) {
+        fprintf(entry, "thresher-cache %d %zu %zu\n", job->status,
+                job->outBuf.len, job->errBuf.len);
+        fwrite(job->outBuf.data, 1, job->outBuf.len, entry);
+        fwrite(job->errBuf.data, 1, job->errBuf.len, entry);
+
+        if (fclose(entry) || rename(temp, path)) {
+            unlink(temp);
+        }
+    }
+
+    free(temp);
+    free(path);
+}
+
+void cache_init(ThresherStruct *ts) {
+
+    struct stat info;
+
+    // An existing directory is used as it is
+    if ((mkdir(ts->cacheDir, 0777) && errno != EEXIST)
+            || stat(ts->cacheDir, &info) || !S_ISDIR(info.st_mode)) {
+        quit(ERR_SYS, 0);
+    }
+}
+
+void cache_trim(ThresherStruct *ts) {
+
+    DIR *dir = opendir(ts->cacheDir);
+    CacheEntry *entries = NULL;
+    int numEntries = 0;
+    off_t total = 0;
+    struct dirent *item;
+    struct stat info;
+    char *path;
+
+    if (!dir) {
+        return;
+    }
+
+    // Find the size and last use of every entry
+    while ((item = readdir(dir))) {
+        if (strlen(item->d_name) != CACHE_KEY_LEN) {
+            continue;
+        }
+
+        path = (char *) malloc(strlen(ts->cacheDir)
+                + strlen(item->d_name) + 2);
+        sprintf(path, "%s/%s", ts->cacheDir, item->d_name);
+
+        if (stat(path, &info) == 0 && S_ISREG(info.st_mode)) {
+            entries = (CacheEntry *) realloc(entries,
+                    sizeof(CacheEntry) * (numEntries + 1));
+            entries[numEntries].name = path;
+            entries[numEntries].size = info.st_size;
+            entries[numEntries++].used = info.st_mtime;
+            total += info.st_size;
+        } else {
+            free(path);
+        }
+    }
+    closedir(dir);
+
+    // Delete the least recently used entries until the rest fit
+    qsort(entries, numEntries, sizeof(CacheEntry), compare_used);
+    for (int i = 0; i < numEntries; ++i) {
+        if (total > ts->cacheSize) {
+            unlink(entries[i].name);
+            total -= entries[i].size;
+        }
+        free(entries[i].name);
+    }
+
+    free(entries);
+}
@@ -0,0 +1,79 @@
+/**
+ * \file   cache.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for cache.c
+ *
+ * \details
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "pool.h"
+
+#define CACHE_DEFAULT_SIZE (64 * 1024 * 1024)
+
+/**\details
+ * Makes the cache directory if it does not exist yet
+ *
+ * Quit with ERR_SYS if it can't be made, or if something other than a
+ * directory is in its place, rather than running without a cache.
+ *
+ * \param ts (ThresherStruct with cacheDir set)
+ */
+void cache_init(ThresherStruct *ts);
+
+/**\details
+ * Works out the cache key of a job
+ *
+ * Hash the build type (its name, command, rules and labels), the command
+ * in ts->cmd, the show value and the contents of the file. The key is
+ * left empty if the file cannot be read, so the job is never cached.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param job (the job to work out the key of, value is modified)
+ */
+void cache_key(ThresherStruct *ts, JobStruct *job);
+
+/**\details
+ * Replays a job from the cache
+ *
+ * If there is an entry for the job's key, fill in the job's output and
+ * exit status from it, mark the job as done and update the entry's time
+ * so it is evicted last.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param job (the job to look up, value is modified)
+ *
+ * \return 1 if the job was found in the cache
+ * \return 0 otherwise
+ */
+int cache_lookup(ThresherStruct *ts, JobStruct *job);
+
+/**\details
+ * Saves a finished job in the cache
+ *
+ * Jobs that exited with status 0 or ERR_NONZERO are saved with their
+ * output, so a job whose compiler was stopped (ERR_STOPPED) is not. The
+ * entry is written to a temporary file and renamed into place so a half
+ * written entry is never read.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param job (the finished job)
+ */
+void cache_store(ThresherStruct *ts, JobStruct *job);
+
+/**\details
+ * Keeps the cache within its size
+ *
+ * If the entries add up to more than ts->cacheSize bytes, delete the
+ * entries used least recently until they fit.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ */
+void cache_trim(ThresherStruct *ts);
+
+#endif
@@ -0,0 +1,155 @@
+/** 
+ * \file   classifier.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the multi-pattern line classifier used by thresher
+ * 
+ * \details
+ *
+ * Rather than searching a line once for every pattern with strstr, the 
+ * patterns for a build type are compiled into one Aho-Corasick automaton.
+ * A line is then searched once, giving a mask of the patterns it contains,
+ * and each build type turns the mask into a table value with its own 
+ * precedence.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include "classifier.h"
+
+/**\details
+ * Adds a new state with no moves and no matches
+ *
+ * \param classifier (the classifier to add to, value is modified)
+ *
+ * \return the new state
+ */
+static int add_state(Classifier *classifier) {
+
+    int state = classifier->numStates++;
+
+    classifier->next = (int (*)[256]) realloc(classifier->next, 
+            sizeof(*classifier->next) * classifier->numStates);
+    classifier->matches = (unsigned int *) realloc(classifier->matches,
+            sizeof(unsigned int) * classifier->numStates);
+
+    // -1 marks a move that is not in the trie
+    for (int i = 0; i < 256; ++i) {
+        classifier->next[state][i] = -1;
+    }
+    classifier->matches[state] = 0;
+
+    return state;
+}
+
+void classifier_init(Classifier *classifier) {
+
+    classifier->numPatterns = 0;
+    classifier->numStates = 0;
+    classifier->next = NULL;
+    classifier->matches = NULL;
+    classifier->fail = NULL;
+    classifier->compiled = 0;
+
+    // State 0 is the root
+    add_state(classifier);
+}
+
+unsigned int classifier_add(Classifier *classifier, const char *pattern) {
+
+    int state = 0;
+    unsigned char c;
+    unsigned int bit;
+
+    // Each pattern needs its own bit of the match mask
+    if (classifier->numPatterns >= MAX_PATTERNS) {
+        return 0;
+    }
+    bit = 1u << classifier->numPatterns++;
+
+    // Follow the pattern through the trie, adding any states it needs
+    for (; *pattern; ++pattern) {
+        c = (unsigned char) *pattern;
+        if (classifier->next[state][c] == -1) {
+            int added = add_state(classifier);
+            classifier->next[state][c] = added;
+        }
+        state = classifier->next[state][c];
+    }
+
+    classifier->matches[state] |= bit;
+
+    return bit;
+}
+
+void classifier_compile(Classifier *classifier) {
+
+    int *queue = (int *) malloc(sizeof(int) * classifier->numStates);
+    int head = 0, tail = 0;
+    int state, child;
+
+    classifier->fail = (int *) calloc(classifier->numStates, sizeof(int));
+
+    // Moves from the root that are not in the trie stay at the root
+    for (int c = 0; c < 256; ++c) {
+        child = classifier->next[0][c];
+        if (child == -1) {
+            classifier->next[0][c] = 0;
+        } else {
+            classifier->fail[child] = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    // Breadth first, so every failure link is finished before it is used
+    while (head < tail) {
+        state = queue[head++];
+        classifier->matches[state] |= 
+                classifier->matches[classifier->fail[state]];
+
+        for (int c = 0; c < 256; ++c) {
+            child = classifier->next[state][c];
+            if (child == -1) {
+                classifier->next[state][c] = 
+                        classifier->next[classifier->fail[state]][c];
+            } else {
+                classifier->fail[child] = 
+                        classifier->next[classifier->fail[state]][c];
+                queue[tail++] = child;
+            }
+        }
+    }
+
+    free(queue);
+    classifier->compiled = 1;
+}
+
+unsigned int classifier_match(Classifier *classifier, const char *line,
+        size_t len) {
+
+    const unsigned char *p = (const unsigned char *) line;
+    const unsigned char *end = p + len;
+    unsigned int found = 0;
+    int state = 0;
+
+    while (p < end) {
+        state = classifier->next[state][*p++];
+        found |= classifier->matches[state];
+    }
+
+    return found;
+}
+
+void classifier_free(Classifier *classifier) {
+
+    free(classifier->next);
+    free(classifier->matches);
+    free(classifier->fail);
+
+    classifier->next = NULL;
+    classifier->matches = NULL;
+    classifier->fail = NULL;
+    classifier->numStates = 0;
+    classifier->numPatterns = 0;
+    classifier->compiled = 0;
+}
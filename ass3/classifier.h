@@ -0,0 +1,87 @@
+/** 
+ * \file   classifier.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for classifier.c
+ *
+ * \details
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
+#include "misc.h"
+
+//! The most patterns a classifier can hold, one bit of its match mask each
+#define MAX_PATTERNS 32
+
+/** \struct Classifier
+ *  \brief An Aho-Corasick automaton that finds which of a set of patterns
+ *          appear in a line in a single pass
+ */
+typedef struct {
+    int numPatterns;        /**< The number of patterns added */
+    int numStates;          /**< The number of states in the automaton */
+    int (*next)[256];       /**< The state to move to for each byte */
+    unsigned int *matches;  /**< Mask of the patterns found in each state */
+    int *fail;              /**< The failure link of each state */
+    int compiled;           /**< Boolean for the automaton being compiled */
+} Classifier;
+
+/**\details
+ * Sets up an empty classifier
+ *
+ * \param classifier (the classifier to set up, value is modified)
+ */
+void classifier_init(Classifier *classifier);
+
+/**\details
+ * Adds a pattern to a classifier that has not been compiled
+ *
+ * Walk the trie of the patterns added so far, adding states for the part
+ * of the pattern that is not already there, and mark the last state as 
+ * matching the pattern. A classifier already holding MAX_PATTERNS 
+ * patterns is left as it is.
+ *
+ * \param classifier (the classifier to add to, value is modified)
+ * \param pattern (the pattern to add)
+ *
+ * \return the bit set in the match mask when the pattern is found
+ * \return 0 if the classifier is full
+ */
+unsigned int classifier_add(Classifier *classifier, const char *pattern);
+
+/**\details
+ * Compiles the classifier's trie into an automaton
+ *
+ * Walk the trie breadth first, setting each state's failure link and 
+ * filling in the missing moves from the failure link's moves, so matching
+ * is a single table lookup per byte. Each state's match mask gets the 
+ * masks of its failure link, so every pattern ending at a byte is seen.
+ *
+ * \param classifier (the classifier to compile, value is modified)
+ */
+void classifier_compile(Classifier *classifier);
+
+/**\details
+ * Finds which of the classifier's patterns appear in a line
+ *
+ * \param classifier (a compiled classifier)
+ * \param line (the line to search)
+ * \param len (the length of the line)
+ *
+ * \return mask with the bit of each pattern found set
+ */
+unsigned int classifier_match(Classifier *classifier, const char *line,
+        size_t len);
+
+/**\details
+ * Frees the memory used by a classifier
+ *
+ * \param classifier (the classifier to free)
+ */
+void classifier_free(Classifier *classifier);
+
+#endif
@@ -0,0 +1,487 @@
+/**
+ * \file   daemon.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the daemon and client used to run thresher over a socket
+ *
+ * \details
+ *
+ * Contains the functions that let a long running thresher serve requests
+ * from thin clients, so a request does not pay for starting thresher.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+
+/** The path of the daemon's socket, removed when the daemon stops */
+static char *socketPath;
+
+extern char **environ;
+
+/**\details
+ * Writes all of a block of bytes, retrying short writes
+ *
+ * \param fd (the file descriptor to write to)
+ * \param data (the bytes to write)
+ * \param len (the number of bytes)
+ *
+ * \return 0 if everything was written
+ * \return -1 otherwise
+ */
+static int write_all(int fd, const char *data, size_t len) {
+
+    ssize_t count;
+
+    while (len > 0) {
+        if ((count = write(fd, data, len)) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += count;
+        len -= count;
+    }
+
+    return 0;
+}
+
+/**\details
+ * Reads exactly len bytes
+ *
+ * \param fd (the file descriptor to read from)
+ * \param data (where to put the bytes)
+ * \param len (the number of bytes)
+ *
+ * \return 0 if every byte was read
+ * \return -1 otherwise
+ */
+static int read_all(int fd, char *data, size_t len) {
+
+    ssize_t count;
+
+    while (len > 0) {
+        if ((count = read(fd, data, len)) <= 0) {
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += count;
+        len -= count;
+    }
+
+    return 0;
+}
+
+/**\details
+ * Reads the first part of a request, along with the client's stdin if it
+ * was passed
+ *
+ * \param conn (the connected socket)
+ * \param data (where to put the bytes)
+ * \param len (the most bytes to read)
+ * \param fd (set to the client's stdin, left as it is if none came)
+ *
+ * \return the number of bytes read, as read does
+ */
+static ssize_t read_fd(int conn, char *data, size_t len, int *fd) {
+
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    ssize_t count;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof(control.space);
+
+    if ((count = recvmsg(conn, &msg, 0)) > 0
+            && (cmsg = CMSG_FIRSTHDR(&msg))
+            && cmsg->cmsg_level == SOL_SOCKET
+            && cmsg->cmsg_type == SCM_RIGHTS
+            && cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+        memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+    return count;
+}
+
+/**\details
+ * Writes a block of bytes with a file descriptor passed on the first byte
+ *
+ * \param conn (the connected socket)
+ * \param data (the bytes to write)
+ * \param len (the number of bytes, at least 1)
+ * \param fd (the file descriptor to pass)
+ *
+ * \return 0 if everything was written
+ * \return -1 otherwise
+ */
+static int write_fd(int conn, const char *data, size_t len, int fd) {
+
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    ssize_t count;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof(control.space);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    while ((count = sendmsg(conn, &msg, 0)) == -1) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    // The descriptor went with the first byte, the rest can follow as is
+    return write_all(conn, data + count, len - count);
+}
+
+/**\details
+ * Sends a frame to the client
+ *
+ * \param conn (the connected socket)
+ * \param type (FRAME_OUT, FRAME_ERR or FRAME_EXIT)
+ * \param data (the bytes of the frame)
+ * \param len (the number of bytes)
+ *
+ * \return 0 if the frame was sent
+ * \return -1 otherwise
+ */
+static int send_frame(int conn, char type, const char *data, size_t len) {
+
+    char header[5];
+    uint32_t size = htonl((uint32_t) len);
+
+    header[0] = type;
+    memcpy(header + 1, &size, sizeof(size));
+
+    return (write_all(conn, header, sizeof(header))
+            || write_all(conn, data, len)) ? -1 : 0;
+}
+
+/**\details
+ * Removes the socket and stops the daemon on SIGINT and SIGTERM
+ *
+ * \param s (The signal number that cauased the function to be called)
+ */
+static void daemon_stop(int s) {
+
+    unlink(socketPath);
+    _exit(0);
+}
+
+void daemon_run(char *path, int jobs) {
+
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    int listener, conn;
+
+    if (jobs < 1) {
+        jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = jobs < 1 ? 1 : jobs;
+    }
+
+    // One token per compiler that may run. Compilers don't need the pipe.
+    if (pipe(jobTokens) || fcntl(jobTokens[READ], F_SETFD, FD_CLOEXEC)
+            || fcntl(jobTokens[WRITE], F_SETFD, FD_CLOEXEC)) {
+        quit(ERR_SYS, 0);
+    }
+    for (int i = 0; i < jobs && i < PIPE_BUF; ++i) {
+        if (write(jobTokens[WRITE], "+", 1) != 1) {
+            quit(ERR_SYS, 0);
+        }
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        quit(ERR_USAGE, 0);
+    }
+    strcpy(addr.sun_path, path);
+
+    // Replace any socket left by a daemon that did not stop cleanly
+    unlink(path);
+    if ((listener = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+            || bind(listener, (struct sockaddr *) &addr, sizeof(addr))
+            || listen(listener, SOMAXCONN)) {
+        quit(ERR_SYS, 0);
+    }
+    socketPath = path;
+
+    // Finished requests are reaped by the system, and a client going away
+    // must not kill the daemon
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sa.sa_flags = SA_NOCLDWAIT;
+    sigaction(SIGCHLD, &sa, 0);
+    sa.sa_flags = 0;
+    sigaction(SIGPIPE, &sa, 0);
+    sa.sa_handler = daemon_stop;
+    sigaction(SIGINT, &sa, 0);
+    sigaction(SIGTERM, &sa, 0);
+
+    while (1) {
+        if ((conn = accept(listener, NULL, NULL)) == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            quit(ERR_SYS, 0);
+        }
+
+        switch (fork()) {
+            case -1:
+                close(conn);
+                break;
+            case 0:
+                close(listener);
+                sa.sa_handler = SIG_DFL;
+                sigaction(SIGCHLD, &sa, 0);
+                sigaction(SIGINT, &sa, 0);
+                sigaction(SIGTERM, &sa, 0);
+                daemon_serve(conn);
+                exit(0);
+            default:
+                close(conn);
+                break;
+        }
+    }
+}
+
+void daemon_serve(int conn) {
+
+    Buffer request = {NULL, 0, 0};
+    char chunk[4096], **args, **envs, *cwd, *arg, *end;
+    int out[2], err[2], numArgs = 0, numEnvs = 0, input = -1, sent, status;
+    struct pollfd fds[3];
+    struct sigaction sa;
+    ssize_t count;
+    pid_t pid;
+
+    // The request ends when the client shuts down its side. Its stdin
+    // comes with the first byte.
+    while ((count = request.len ? read(conn, chunk, sizeof(chunk))
+            : read_fd(conn, chunk, sizeof(chunk), &input)) != 0) {
+        if (count == -1 && errno != EINTR) {
+            exit(ERR_SYS);
+        }
+        if (count > 0) {
+            buffer_append(&request, chunk, count);
+        }
+    }
+    if (!request.len || request.data[request.len - 1] != '\0') {
+        exit(ERR_SYS);
+    }
+
+    // Split the request into the directory, the arguments with "thresher"
+    // in front as argv[0], and the environment
+    args = (char **) malloc(sizeof(char *) * (request.len + 2));
+    envs = (char **) malloc(sizeof(char *) * (request.len + 1));
+    args[numArgs++] = "thresher";
+    cwd = request.data;
+    end = request.data + request.len;
+    arg = cwd + strlen(cwd) + 1;
+    if (arg >= end || sscanf(arg, "%d%c", &sent, chunk) != 1 || sent < 0) {
+        exit(ERR_SYS);
+    }
+    for (arg += strlen(arg) + 1; arg < end; arg += strlen(arg) + 1) {
+        if (numArgs <= sent) {
+            args[numArgs++] = arg;
+        } else {
+            envs[numEnvs++] = arg;
+        }
+    }
+    if (numArgs <= sent) {
+        exit(ERR_SYS);
+    }
+    args[numArgs] = NULL;
+    envs[numEnvs] = NULL;
+    if (input == -1 && (input = open("/dev/null", O_RDONLY)) == -1) {
+        exit(ERR_SYS);
+    }
+
+    if (pipe(out) || pipe(err)) {
+        exit(ERR_SYS);
+    }
+
+    switch (pid = fork()) {
+        case -1:
+            exit(ERR_SYS);
+        case 0:
+            close(conn);
+            if (dup2(input, STDIN_FILENO) == -1
+                    || dup2(out[WRITE], STDOUT_FILENO) == -1
+                    || dup2(err[WRITE], STDERR_FILENO) == -1
+                    || close(input)
+                    || close(out[READ]) || close(out[WRITE])
+                    || close(err[READ]) || close(err[WRITE])) {
+                exit(ERR_SYS);
+            }
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = SIG_DFL;
+            sigaction(SIGPIPE, &sa, 0);
+
+            // The compilers are found and run with the client's
+            // environment
+            environ = envs;
+            if (chdir(cwd)) {
+                quit(ERR_SYS, 0);
+            }
+            exit(thresher_run(numArgs, args));
+    }
+
+    close(input);
+    close(out[WRITE]);
+    close(err[WRITE]);
+
+    // Send the output on as it arrives. The client has already shut down
+    // its side, so only a hang up on the socket means the client has gone.
+    fds[0].fd = out[READ];
+    fds[1].fd = err[READ];
+    fds[2].fd = conn;
+    fds[0].events = fds[1].events = POLLIN;
+    fds[2].events = 0;
+
+    while (fds[0].fd != -1 || fds[1].fd != -1) {
+        if (poll(fds, 3, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            count = read(fds[i].fd, chunk, sizeof(chunk));
+            if (count > 0) {
+                if (send_frame(conn, i ? FRAME_ERR : FRAME_OUT, chunk,
+                        count) && fds[2].fd != -1) {
+                    kill(pid, SIGINT);
+                    fds[2].fd = -1;
+                }
+            } else if (count == 0 || errno != EINTR) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+            }
+        }
+
+        // Interrupt the run, so its compilers are stopped, if the client
+        // has gone
+        if (fds[2].revents & (POLLHUP | POLLERR)) {
+            kill(pid, SIGINT);
+            fds[2].fd = -1;
+        }
+    }
+
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    chunk[0] = (char) (WIFEXITED(status) ? WEXITSTATUS(status) : ERR_SYS);
+    send_frame(conn, FRAME_EXIT, chunk, 1);
+
+    close(conn);
+    free(args);
+    free(envs);
+    free(request.data);
+}
+
+int daemon_connect(char *path, int argc, char **argv) {
+
+    struct sockaddr_un addr;
+    char header[5], number[16], *cwd, *data = NULL;
+    uint32_t size;
+    int conn;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        quit(ERR_USAGE, 0);
+    }
+    strcpy(addr.sun_path, path);
+
+    if ((conn = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+            || connect(conn, (struct sockaddr *) &addr, sizeof(addr))
+            || !(cwd = getcwd(NULL, 0))) {
+        quit(ERR_SYS, 0);
+    }
+
+    // Send the directory with stdin, then the number of arguments, the
+    // arguments and the environment, each with its terminator
+    sprintf(number, "%d", argc);
+    if (write_fd(conn, cwd, strlen(cwd) + 1, STDIN_FILENO)
+            || write_all(conn, number, strlen(number) + 1)) {
+        quit(ERR_SYS, 0);
+    }
+    for (int i = 0; i < argc; ++i) {
+        if (write_all(conn, argv[i], strlen(argv[i]) + 1)) {
+            quit(ERR_SYS, 0);
+        }
+    }
+    for (char **env = environ; *env; ++env) {
+        if (write_all(conn, *env, strlen(*env) + 1)) {
+            quit(ERR_SYS, 0);
+        }
+    }
+    shutdown(conn, SHUT_WR);
+    free(cwd);
+
+    // Write out each frame until the exit status arrives
+    while (read_all(conn, header, sizeof(header)) == 0) {
+        memcpy(&size, header + 1, sizeof(size));
+        size = ntohl(size);
+        data = (char *) realloc(data, size + 1);
+
+        if (read_all(conn, data, size)) {
+            break;
+        }
+
+        if (header[0] == FRAME_OUT) {
+            fwrite(data, 1, size, stdout);
+            fflush(stdout);
+        } else if (header[0] == FRAME_ERR) {
+            fwrite(data, 1, size, stderr);
+        } else if (header[0] == FRAME_EXIT && size == 1) {
+            int status = (unsigned char) data[0];
+
+            free(data);
+            close(conn);
+            return status;
+        }
+    }
+
+    // The daemon went away without an exit status
+    quit(ERR_SYS, 0);
+    return ERR_SYS;
+}
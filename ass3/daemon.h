@@ -0,0 +1,88 @@
+/**
+ * \file   daemon.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for daemon.c
+ *
+ * \details
+ *
+ * A client sends a request as NUL terminated strings: the directory it was
+ * run in, the number of arguments in decimal, its arguments (everything
+ * after "--connect socket"), then its environment. Its stdin is passed
+ * with SCM_RIGHTS on the first byte. It then shuts down its side of the
+ * socket. The daemon answers with frames,
+ * each a type byte, a 4 byte length in network order and that many bytes:
+ *
+ *     'O'   bytes thresher wrote to stdout
+ *     'E'   bytes thresher wrote to stderr
+ *     'X'   one byte, the exit status thresher quit with (always last)
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "thresherSupport.h"
+
+#define FRAME_OUT 'O'
+#define FRAME_ERR 'E'
+#define FRAME_EXIT 'X'
+
+/**\details
+ * Runs thresher with the arguments given, as main does
+ *
+ * Defined in thresher.c.
+ *
+ * \param argc (int of the number of arguments)
+ * \param argv (string array containing the arguments)
+ *
+ * \return the status to exit with
+ */
+int thresher_run(int argc, char **argv);
+
+/**\details
+ * Runs thresher as a daemon that serves requests on a Unix socket
+ *
+ * Fill jobTokens with jobs tokens (one per core if jobs is 0), so no more
+ * than jobs compilers run at once across every request. Then accept
+ * connections forever, forking a process to serve each one (daemon_serve).
+ * On SIGINT or SIGTERM, remove the socket and exit with status 0.
+ *
+ * \param path (the path to create the socket at)
+ * \param jobs (the most compilers to run at once, 0 for one per core)
+ */
+void daemon_run(char *path, int jobs);
+
+/**\details
+ * Serves one request
+ *
+ * Read the request, then fork a process that takes the client's stdin and
+ * environment, changes to the client's directory and runs thresher_run
+ * with its stdout and stderr sent down pipes. Without a stdin from the
+ * client, /dev/null is used. The jobs are still limited by the daemon's
+ * tokens, not the client's make jobserver. Send what arrives on the pipes
+ * to the client as it arrives, then send the exit status. If the client
+ * goes away, interrupt the run.
+ *
+ * \param conn (the connected socket)
+ */
+void daemon_serve(int conn);
+
+/**\details
+ * Runs a request on a daemon and behaves like thresher would have
+ *
+ * Send the current directory, the arguments, the environment and stdin,
+ * then write the output the
+ * daemon sends to stdout and stderr. If the daemon cannot be reached or
+ * goes away, quit with ERR_SYS.
+ *
+ * \param path (the path of the daemon's socket)
+ * \param argc (the number of arguments to send)
+ * \param argv (the arguments to send)
+ *
+ * \return the status thresher quit with on the daemon
+ */
+int daemon_connect(char *path, int argc, char **argv);
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * \file   diag.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the diagnostic counting used by thresher's --top
+ *
+ * \details
+ *
+ * Contains the hash table that counts each distinct diagnostic message
+ * across every file, and the report of the most common ones.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include "diag.h"
+
+/**\details
+ * Hashes a message with 64 bit FNV-1a, never giving 0 (an unused slot)
+ *
+ * \param data (the message)
+ * \param len (the length of the message)
+ *
+ * \return the hash
+ */
+static unsigned long long diag_hash(const char *data, size_t len) {
+
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+    }
+
+    return hash ? hash : 1;
+}
+
+/**\details
+ * Doubles the number of slots, putting every entry in its new slot
+ *
+ * \param table (the table to grow, value is modified)
+ */
+static void diag_grow(DiagTable *table) {
+
+    DiagEntry *old = table->entries;
+    size_t oldSize = table->size;
+
+    table->size = oldSize ? oldSize * 2 : 1024;
+    table->entries = (DiagEntry *) calloc(table->size, sizeof(DiagEntry));
+
+    for (size_t i = 0; i < oldSize; ++i) {
+        if (old[i].hash) {
+            size_t slot = old[i].hash & (table->size - 1);
+
+            while (table->entries[slot].hash) {
+                slot = (slot + 1) & (table->size - 1);
+            }
+            table->entries[slot] = old[i];
+        }
+    }
+
+    free(old);
+}
+
+/**\details
+ * Orders entries from most to least common for qsort, with the message
+ * seen first winning a tie
+ *
+ * \param a (pointer to the first entry)
+ * \param b (pointer to the second entry)
+ *
+ * \return the order of the entries
+ */
+static int compare_count(const void *a, const void *b) {
+
+    const DiagEntry *x = (const DiagEntry *) a;
+    const DiagEntry *y = (const DiagEntry *) b;
+
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    return (x->message > y->message) - (x->message < y->message);
+}
+
+/**\details
+ * Orders entries by when their message was first seen for qsort
+ *
+ * \param a (pointer to the first entry)
+ * \param b (pointer to the second entry)
+ *
+ * \return the order of the entries
+ */
+static int compare_seen(const void *a, const void *b) {
+
+    size_t x = ((const DiagEntry *) a)->message;
+    size_t y = ((const DiagEntry *) b)->message;
+
+    return (x > y) - (x < y);
+}
+
+/**\details
+ * Copies the entries in use out of the table and sorts them
+ *
+ * \param table (the table)
+ * \param compare (the order to sort them in, for qsort)
+ *
+ * \return the table->used entries, free with free()
+ */
+static DiagEntry *sorted_entries(DiagTable *table,
+        int (*compare)(const void *, const void *)) {
+
+    DiagEntry *sorted = (DiagEntry *) malloc(sizeof(DiagEntry)
+            * (table->used + 1));
+    size_t num = 0;
+
+    for (size_t i = 0; i < table->size; ++i) {
+        if (table->entries[i].hash) {
+            sorted[num++] = table->entries[i];
+        }
+    }
+    qsort(sorted, num, sizeof(DiagEntry), compare);
+
+    return sorted;
+}
+
+void diag_init(DiagTable *table) {
+
+    memset(table, 0, sizeof(DiagTable));
+}
+
+void diag_add(DiagTable *table, const char *message, size_t len,
+        const char *location, size_t locLen, int count) {
+
+    unsigned long long hash = diag_hash(message, len);
+    DiagEntry *entry;
+    size_t slot;
+
+    // Keep at least a quarter of the slots free so probes stay short
+    if ((table->used + 1) * 4 > table->size * 3) {
+        diag_grow(table);
+    }
+
+    for (slot = hash & (table->size - 1); table->entries[slot].hash;
+            slot = (slot + 1) & (table->size - 1)) {
+        entry = &table->entries[slot];
+        if (entry->hash == hash && entry->length == len
+                && !memcmp(table->text.data + entry->message, message,
+                len)) {
+            entry->count += count;
+            return;
+        }
+    }
+
+    // A new message, store it and its location once
+    entry = &table->entries[slot];
+    entry->hash = hash;
+    entry->count = count;
+    entry->length = len;
+    entry->message = table->text.len;
+    buffer_append(&table->text, message, len);
+    buffer_append(&table->text, "", 1);
+    entry->location = table->text.len;
+    buffer_append(&table->text, location, locLen);
+    buffer_append(&table->text, "", 1);
+    table->used++;
+}
+
+void diag_add_line(DiagTable *table, BuildType *bt, const char *line,
+        size_t len, const char *file) {
+
+    const char *end = line + len, *p, *message;
+
+    if (!bt->prefix) {
+        diag_add(table, line, len, file, strlen(file), 1);
+        return;
+    }
+
+    // Skip "file:line:" and a following "column:" if there is one
+    p = (const char *) memchr(line, ':', len);
+    p = p ? p + 1 : end;
+    while (p < end && *p >= '0' && *p <= '9') {
+        p++;
+    }
+    if (p < end && *p == ':') {
+        const char *column = p + 1;
+
+        while (column < end && *column >= '0' && *column <= '9') {
+            column++;
+        }
+        if (column > p + 1 && column < end && *column == ':') {
+            p = column;
+        }
+    }
+
+    // The location is everything before the last ':' skipped, the message
+    // everything after it (less leading spaces)
+    message = p < end ? p + 1 : end;
+    while (message < end && *message == ' ') {
+        message++;
+    }
+    diag_add(table, message, end - message, line, p - line, 1);
+}
+
+void diag_merge(DiagTable *table, DiagTable *from) {
+
+    // Add in the order the messages were first seen, so examples stay the
+    // first place a message was seen
+    DiagEntry *sorted = sorted_entries(from, compare_seen);
+
+    for (size_t i = 0; i < from->used; ++i) {
+        const char *location = from->text.data + sorted[i].location;
+
+        diag_add(table, from->text.data + sorted[i].message, 
+                sorted[i].length, location, strlen(location), 
+                sorted[i].count);
+    }
+
+    free(sorted);
+}
+
+void diag_write(DiagTable *table, int fd) {
+
+    FILE *out = fdopen(dup(fd), "w");
+    DiagEntry *sorted;
+
+    if (!out) {
+        return;
+    }
+
+    // Write in the order the messages were first seen, as diag_merge adds
+    sorted = sorted_entries(table, compare_seen);
+    for (size_t i = 0; i < table->used; ++i) {
+        fprintf(out, "%d\t%s\t", sorted[i].count,
+                table->text.data + sorted[i].location);
+        fwrite(table->text.data + sorted[i].message, 1, sorted[i].length, 
+                out);
+        fputc('\n', out);
+    }
+
+    free(sorted);
+    fclose(out);
+}
+
+void diag_read(DiagTable *table, const char *data, size_t len) {
+
+    const char *end = data + len, *line, *next, *tab1, *tab2;
+    int count;
+
+    for (line = data; line < end; line = next) {
+        next = (const char *) memchr(line, '\n', end - line);
+        next = next ? next : end;
+
+        tab1 = (const char *) memchr(line, '\t', next - line);
+        tab2 = tab1 ? (const char *) memchr(tab1 + 1, '\t', next - tab1 - 1)
+                : NULL;
+        if (tab2 && sscanf(line, "%d", &count) == 1) {
+            diag_add(table, tab2 + 1, next - tab2 - 1, tab1 + 1,
+                    tab2 - tab1 - 1, count);
+        }
+
+        next = next < end ? next + 1 : end;
+    }
+}
+
+void diag_print_top(DiagTable *table, int num) {
+
+    DiagEntry *sorted = sorted_entries(table, compare_count);
+
+    printf("----\n");
+    for (size_t i = 0; i < table->used && i < (size_t) num; ++i) {
+        printf("%d %s\n    %s\n", sorted[i].count,
+                table->text.data + sorted[i].message,
+                table->text.data + sorted[i].location);
+    }
+    printf("----\n");
+
+    free(sorted);
+}
+
+void diag_free(DiagTable *table) {
+
+    free(table->entries);
+    free(table->text.data);
+    diag_init(table);
+}
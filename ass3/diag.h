@@ -0,0 +1,125 @@
+/**
+ * \file   diag.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for diag.c
+ *
+ * \details
+ *
+ * A worker sends its diagnostics to the parent as lines of
+ *
+ *     count TAB location TAB message
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#include "rules.h"
+
+/** \struct DiagEntry
+ *  \brief One distinct diagnostic message and how often it was seen
+ */
+typedef struct {
+    unsigned long long hash;    /**< Hash of the message, 0 if unused */
+    int count;              /**< The number of times it was seen */
+    size_t message;         /**< Offset of the message in the text */
+    size_t length;          /**< The length of the message */
+    size_t location;        /**< Offset of the first location in the text */
+} DiagEntry;
+
+/** \struct DiagTable
+ *  \brief A hash table of diagnostic messages, with every message and
+ *          example location stored once in one block of text
+ */
+typedef struct {
+    DiagEntry *entries;     /**< The slots of the table */
+    size_t size;            /**< The number of slots, a power of 2 */
+    size_t used;            /**< The number of slots in use */
+    Buffer text;            /**< The messages and locations, terminated */
+} DiagTable;
+
+/**\details
+ * Sets up an empty table
+ *
+ * \param table (the table to set up, value is modified)
+ */
+void diag_init(DiagTable *table);
+
+/**\details
+ * Counts a message
+ *
+ * If the message is in the table, add count to it. Otherwise add it with
+ * location as its example.
+ *
+ * \param table (the table to add to, value is modified)
+ * \param message (the message, not terminated)
+ * \param len (the length of the message)
+ * \param location (where the message was seen, not terminated)
+ * \param locLen (the length of location)
+ * \param count (the number of times it was seen)
+ */
+void diag_add(DiagTable *table, const char *message, size_t len,
+        const char *location, size_t locLen, int count);
+
+/**\details
+ * Counts a line of compiler output
+ *
+ * For build types with a prefix, the "file:line:column: " at the start is
+ * the location and the rest is the message. For other build types, the
+ * file is the location and the line is the message.
+ *
+ * \param table (the table to add to, value is modified)
+ * \param bt (the build type of the line)
+ * \param line (the line, not terminated)
+ * \param len (the length of the line)
+ * \param file (string for the file the line is about)
+ */
+void diag_add_line(DiagTable *table, BuildType *bt, const char *line,
+        size_t len, const char *file);
+
+/**\details
+ * Adds every message of one table to another
+ *
+ * \param table (the table to add to, value is modified)
+ * \param from (the table to add)
+ */
+void diag_merge(DiagTable *table, DiagTable *from);
+
+/**\details
+ * Writes the table down a file descriptor for another process to read
+ *
+ * \param table (the table to write)
+ * \param fd (the file descriptor to write to)
+ */
+void diag_write(DiagTable *table, int fd);
+
+/**\details
+ * Adds the messages written by diag_write
+ *
+ * \param table (the table to add to, value is modified)
+ * \param data (what diag_write wrote)
+ * \param len (the length of data)
+ */
+void diag_read(DiagTable *table, const char *data, size_t len);
+
+/**\details
+ * Prints the most common messages
+ *
+ * Between lines of dashes, print up to num messages, most common first,
+ * each with its count and then the first place it was seen.
+ *
+ * \param table (the table to print)
+ * \param num (the most messages to print)
+ */
+void diag_print_top(DiagTable *table, int num);
+
+/**\details
+ * Frees the memory used by a table
+ *
+ * \param table (the table to free)
+ */
+void diag_free(DiagTable *table);
+
+#endif
@@ -0,0 +1,260 @@
+/**
+ * \file   fakeCompiler.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Prints compiler output for thresher to be measured against
+ *
+ * \details
+ *
+ * Usage: fakeCompiler [-n lines] [-t gcc|javac|latex] 
+ *                     [-interaction=nonstopmode] [options] [file]
+ *
+ * Prints lines (default $FAKECC_LINES, or 1000) lines of the diagnostics
+ * gcc, javac or latex print, about file. The style is given by -t or by
+ * the extension of file (.java javac, .tex latex, otherwise gcc), and any
+ * other options (like those of the build type's command) are ignored.
+ *
+ * gcc and javac print to stderr and latex to stdout, as thresher expects.
+ * Like latex, each error and warning stops at a "? " prompt until a reply
+ * has been read from stdin. A reply starting with X stops the run, as it
+ * does for latex, and end of input is taken as return. With
+ * -interaction=nonstopmode there are no prompts, and the lines are also
+ * written to the file's .log in the working directory, as latex would.
+ *
+ * Without a file, it is a compile server (see server.h) that prints the
+ * lines for each file named on stdin. $FAKECC_STARTUP is the milliseconds
+ * it takes to start, to stand in for a compiler like javac's JVM, and 
+ * $FAKECC_SERVE is the number of files it serves before it ends (default
+ * every file), to stand in for a server that dies.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include "misc.h"
+#include "server.h"
+
+//! The lines gcc prints for one function, %s is the file and the first %d
+//! the line (the other numbers are only there to make each line differ)
+static const char *gccLines[] = {
+        "%s: In function 'f%d':",
+        "%s:%d:5: warning: implicit declaration of function 'foo%d' "
+        "[-Wimplicit-function-declaration]",
+        "%d |     foo(x);",
+        "  |     ^~~",
+        "%s:%d:12: error: 'x%d' undeclared (first use in this function)",
+        "%s:%d:12: note: each undeclared identifier is reported only once "
+        "for each function it appears in",
+        "%s:%d:9: warning: unused variable 'y%d' [-Wunused-variable]",
+        "%s:%d:1: warning: control reaches end of non-void function "
+        "[-Wreturn-type]",
+        NULL
+};
+
+//! The lines javac prints for one method
+static const char *javacLines[] = {
+        "%s:%d: error: cannot find symbol",
+        "        foo%d(x);",
+        "        ^",
+        "  symbol:   method foo%d(int)",
+        "  location: class Test",
+        "%s:%d: error: <identifier> expected",
+        "%s:%d: error: non-static variable x%d cannot be referenced from a "
+        "static context",
+        NULL
+};
+
+//! The lines latex prints for one paragraph, a line starting with '!' is
+//! an error
+static const char *latexLines[] = {
+        "Overfull \\hbox (%d.0pt too wide) in paragraph at lines %d--%d",
+        "LaTeX Warning: Reference `sec%d' on page %d undefined on input line "
+        "%d.",
+        "! Undefined control sequence.",
+        "l.%d \\foo%d",
+        "! Missing $ inserted.",
+        "<inserted text> ",
+        "                $",
+        "l.%d x_%d",
+        "Underfull \\hbox (badness %d) in paragraph at lines %d--%d",
+        NULL
+};
+
+/**\details
+ * Prints fakeCompiler's usage and exits with ERR_USAGE
+ */
+static void usage(void) {
+
+    fprintf(stderr, "Usage: fakeCompiler [-n lines] [-t gcc|javac|latex]\n"
+            "                    [-interaction=nonstopmode] [options] "
+            "[file]\n");
+    exit(ERR_USAGE);
+}
+
+/**\details
+ * Prints one line, filling in the file for styles with a prefix
+ *
+ * \param out (the stream to print to)
+ * \param format (the line, as in gccLines)
+ * \param file (the file the line is about)
+ * \param number (the line's number)
+ */
+static void print_line(FILE *out, const char *format, char *file,
+        int number) {
+
+    if (!strncmp(format, "%s", 2)) {
+        fprintf(out, format, file, number, number, number);
+    } else {
+        fprintf(out, format, number, number, number);
+    }
+    fputc('\n', out);
+}
+
+/**\details
+ * Waits at a prompt for a reply, as latex does after an error or warning
+ *
+ * \param out (the stream the prompt is printed to)
+ *
+ * \return 1 if the reply asks to stop, otherwise 0
+ */
+static int prompt(FILE *out) {
+
+    char reply[256];
+
+    fputs("? ", out);
+    fflush(out);
+
+    return fgets(reply, sizeof(reply), stdin) && reply[0] == 'X';
+}
+
+/**\details
+ * Prints the lines for one file, as one run of the compiler would
+ *
+ * \param file (the file the lines are about)
+ * \param style (gcc, javac, latex or NULL to go by the file's extension)
+ * \param count (the number of lines)
+ * \param nonstop (boolean for latex writing a log rather than prompting)
+ * \param server (boolean for being a compile server, which ends the lines
+ * with SERVER_DONE and cannot prompt, as its stdin is the files)
+ *
+ * \return the exit status the compiler would give
+ */
+static int compile(char *file, char *style, int count, int nonstop,
+        int server) {
+
+    const char **lines = gccLines, *ext = strrchr(file, '.');
+    FILE *out = stderr, *log = NULL;
+    int status;
+
+    if (!style) {
+        style = ext && !strcmp(ext, ".java") ? "javac"
+                : ext && !strcmp(ext, ".tex") ? "latex" : "gcc";
+    }
+    if (!strcmp(style, "javac")) {
+        lines = javacLines;
+    } else if (!strcmp(style, "latex")) {
+        lines = latexLines;
+        out = stdout;
+    } else if (strcmp(style, "gcc")) {
+        usage();
+    }
+
+    // latex writes its log beside where it was run, named after the file
+    if (nonstop && lines == latexLines) {
+        char *base = strrchr(file, '/'), path[4096], *dot;
+
+        snprintf(path, sizeof(path) - 4, "%s", base ? base + 1 : file);
+        if ((dot = strrchr(path, '.'))) {
+            *dot = '\0';
+        }
+        strcat(path, ".log");
+        if (!(log = fopen(path, "w"))) {
+            quit(ERR_SYS, 0);
+        }
+    }
+
+    for (int i = 0, next = 0; i < count; ++i) {
+        if (!lines[next]) {
+            next = 0;
+        }
+        print_line(out, lines[next], file, i + 1);
+        if (log) {
+            print_line(log, lines[next], file, i + 1);
+        }
+
+        // latex waits for a reply after each error and warning
+        if (lines == latexLines && !log && !server && (lines[next][0] == '!'
+                || !strncmp(lines[next], "LaTeX Warning", 13))
+                && prompt(out)) {
+            fprintf(out, "No pages of output.\n");
+            return 1;
+        }
+        next++;
+    }
+
+    if (log) {
+        fclose(log);
+    }
+
+    status = lines == gccLines || lines == javacLines;
+    if (server) {
+        fprintf(out, SERVER_DONE "%d\n", status);
+        fflush(out);
+    }
+    return status;
+}
+
+int main(int argc, char **argv) {
+
+    char *style = NULL, *file = NULL, *env = getenv("FAKECC_LINES");
+    char name[4096];
+    int count = 1000, nonstop = 0, startup = 0, serve = 0;
+
+    if (env && !get_num_arg(env, &count)) {
+        usage();
+    }
+    if ((env = getenv("FAKECC_STARTUP")) && !get_num_arg(env, &startup)) {
+        usage();
+    }
+    if ((env = getenv("FAKECC_SERVE")) && !get_num_arg(env, &serve)) {
+        usage();
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            if (!get_num_arg(argv[++i], &count)) {
+                usage();
+            }
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            style = argv[++i];
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            i++;
+        } else if (!strcmp(argv[i], "-interaction=nonstopmode")) {
+            nonstop = 1;
+        } else if (argv[i][0] != '-') {
+            file = argv[i];
+        }
+    }
+
+    // Stand in for the time the real compiler takes to start, such as a
+    // JVM's
+    usleep(startup * 1000);
+
+    // Buffer the output as the real compilers do, rather than writing
+    // stderr a piece at a time
+    setvbuf(stdout, NULL, _IOFBF, 65536);
+    setvbuf(stderr, NULL, _IOFBF, 65536);
+
+    if (file) {
+        return compile(file, style, count, nonstop, 0);
+    }
+
+    // Without a file, serve each file named on stdin (see server.h), or
+    // only the first serve of them
+    for (int served = 0; (!serve || served < serve) 
+            && fgets(name, sizeof(name), stdin); ++served) {
+        name[strcspn(name, "\n")] = '\0';
+        compile(name, style, count, nonstop, 1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,230 @@
+/**
+ * \file   history.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the compile time history used to schedule the pool
+ *
+ * \details
+ *
+ * Contains the functions that remember how long each file took to compile
+ * and order the files so the longest start first, so a large file given
+ * last does not run on its own after the others have finished.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <sys/stat.h>
+
+#include "history.h"
+
+/** \struct Expected
+ *  \brief How long a file is expected to take, for sorting
+ */
+typedef struct {
+    double ms;              /**< The expected wall time */
+    int index;              /**< The file's index in the files given */
+} Expected;
+
+/**\details
+ * Finds where a file is, or would be, in the sorted entries
+ *
+ * \param history (the history)
+ * \param file (the file)
+ *
+ * \return the index of the first entry not before file
+ */
+static int find_index(History *history, const char *file) {
+
+    int low = 0, high = history->count, mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (strcmp(history->entries[mid].file, file) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**\details
+ * Compares two entries by file for qsort
+ *
+ * \param a (pointer to the first entry)
+ * \param b (pointer to the second entry)
+ *
+ * \return the order of the entries, as strcmp
+ */
+static int compare_entries(const void *a, const void *b) {
+
+    return strcmp(((const HistoryEntry *) a)->file, 
+            ((const HistoryEntry *) b)->file);
+}
+
+/**\details
+ * Compares two files by how long they are expected to take for qsort,
+ * longest first and then in the order given
+ *
+ * \param a (pointer to the first Expected)
+ * \param b (pointer to the second Expected)
+ *
+ * \return the order of the files
+ */
+static int compare_expected(const void *a, const void *b) {
+
+    const Expected *x = (const Expected *) a, *y = (const Expected *) b;
+
+    if (x->ms != y->ms) {
+        return x->ms > y->ms ? -1 : 1;
+    }
+    return x->index - y->index;
+}
+
+void history_load(History *history, const char *path) {
+
+    FILE *file = fopen(path, "r");
+    char *line = NULL, *tab, *end;
+    size_t size = 0;
+    ssize_t len;
+    double ms;
+
+    history->entries = NULL;
+    history->count = 0;
+    history->changed = 0;
+
+    if (!file) {
+        return;
+    }
+
+    while ((len = getline(&line, &size, file)) > 0) {
+        if (line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+
+        ms = strtod(line, &end);
+        if (!(tab = strchr(line, '\t')) || end != tab || ms < 0 
+                || tab[1] == '\0') {
+            continue;
+        }
+
+        history->entries = (HistoryEntry *) realloc(history->entries,
+                sizeof(HistoryEntry) * (history->count + 1));
+        history->entries[history->count].file = strdup(tab + 1);
+        history->entries[history->count++].ms = ms;
+    }
+    free(line);
+    fclose(file);
+
+    qsort(history->entries, history->count, sizeof(HistoryEntry), 
+            compare_entries);
+}
+
+double history_find(History *history, const char *file) {
+
+    int index = find_index(history, file);
+
+    if (index < history->count 
+            && !strcmp(history->entries[index].file, file)) {
+        return history->entries[index].ms;
+    }
+
+    return -1;
+}
+
+void history_set(History *history, const char *file, double ms) {
+
+    int index = find_index(history, file);
+
+    history->changed = 1;
+
+    if (index < history->count 
+            && !strcmp(history->entries[index].file, file)) {
+        history->entries[index].ms = ms;
+        return;
+    }
+
+    // Keep the entries sorted
+    history->entries = (HistoryEntry *) realloc(history->entries,
+            sizeof(HistoryEntry) * (history->count + 1));
+    memmove(&history->entries[index + 1], &history->entries[index],
+            sizeof(HistoryEntry) * (history->count - index));
+    history->entries[index].file = strdup(file);
+    history->entries[index].ms = ms;
+    history->count++;
+}
+
+void history_order(History *history, char **files, int numFiles, 
+        int *order) {
+
+    Expected *expected = (Expected *) malloc(sizeof(Expected) * numFiles);
+    double knownMs = 0, knownSize = 0, rate;
+    off_t *sizes = (off_t *) malloc(sizeof(off_t) * numFiles);
+    struct stat info;
+
+    // Work out how long the files in the history took per byte
+    for (int i = 0; i < numFiles; ++i) {
+        sizes[i] = stat(files[i], &info) ? 0 : info.st_size;
+        expected[i].index = i;
+        expected[i].ms = history_find(history, files[i]);
+        if (expected[i].ms >= 0) {
+            knownMs += expected[i].ms;
+            knownSize += sizes[i];
+        }
+    }
+    rate = knownMs > 0 && knownSize > 0 ? knownMs / knownSize : 1;
+
+    // Guess the rest from their size
+    for (int i = 0; i < numFiles; ++i) {
+        if (expected[i].ms < 0) {
+            expected[i].ms = sizes[i] * rate;
+        }
+    }
+
+    qsort(expected, numFiles, sizeof(Expected), compare_expected);
+    for (int i = 0; i < numFiles; ++i) {
+        order[i] = expected[i].index;
+    }
+
+    free(sizes);
+    free(expected);
+}
+
+void history_save(History *history, const char *path) {
+
+    char *temp;
+    FILE *file;
+
+    if (!history->changed) {
+        return;
+    }
+
+    // Write beside the history, then move it into place
+    temp = (char *) malloc(strlen(path) + 32);
+    sprintf(temp, "%s.%d", path, (int) getpid());
+    if (!(file = fopen(temp, "w"))) {
+        free(temp);
+        return;
+    }
+
+    for (int i = 0; i < history->count; ++i) {
+        fprintf(file, "%.3f\t%s\n", history->entries[i].ms, 
+                history->entries[i].file);
+    }
+
+    if (fclose(file) || rename(temp, path)) {
+        unlink(temp);
+    }
+    free(temp);
+}
+
+void history_free(History *history) {
+
+    for (int i = 0; i < history->count; ++i) {
+        free(history->entries[i].file);
+    }
+    free(history->entries);
+    history->entries = NULL;
+    history->count = 0;
+}
@@ -0,0 +1,102 @@
+/**
+ * \file   history.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for history.c
+ *
+ * \details
+ *
+ * The history file holds how long each file took to compile the last time
+ * it was run, one file to a line:
+ *
+ *     milliseconds<TAB>file
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "misc.h"
+
+/** \struct HistoryEntry
+ *  \brief How long one file took to compile
+ */
+typedef struct {
+    char *file;             /**< The file, as it was given */
+    double ms;              /**< The wall time of its last run */
+} HistoryEntry;
+
+/** \struct History
+ *  \brief The compile times of every file in a history file
+ */
+typedef struct {
+    HistoryEntry *entries;  /**< The entries, sorted by file */
+    int count;              /**< The number of entries */
+    int changed;            /**< Boolean for there being times to save */
+} History;
+
+/**\details
+ * Reads a history file. A missing file is an empty history, and lines
+ * that cannot be read are skipped.
+ *
+ * \param history (the history to fill in, value is modified)
+ * \param path (the path of the history file)
+ */
+void history_load(History *history, const char *path);
+
+/**\details
+ * Finds how long a file took last time
+ *
+ * \param history (the history)
+ * \param file (the file)
+ *
+ * \return the milliseconds it took, or -1 if it has not been run
+ */
+double history_find(History *history, const char *file);
+
+/**\details
+ * Sets how long a file took, adding it to the history if it is new
+ *
+ * \param history (the history, value is modified)
+ * \param file (the file)
+ * \param ms (the milliseconds it took)
+ */
+void history_set(History *history, const char *file, double ms);
+
+/**\details
+ * Orders files longest first, for the longest processing time first
+ * schedule.
+ *
+ * A file in the history is expected to take as long as it did last time.
+ * Any other file is expected to take as long per byte as the files in the
+ * history did on average (or its size, if none are), so large new files 
+ * still start early. Files expected to take as long as each other stay in
+ * the order given.
+ *
+ * \param history (the history)
+ * \param files (string array of the files)
+ * \param numFiles (the number of files)
+ * \param order (set to the indexes of files in the order to start them)
+ */
+void history_order(History *history, char **files, int numFiles, 
+        int *order);
+
+/**\details
+ * Writes the history back if any times have been set, replacing the file
+ * in one step (through a temporary file) so a run that is reading it 
+ * never sees half of it.
+ *
+ * \param history (the history)
+ * \param path (the path of the history file)
+ */
+void history_save(History *history, const char *path);
+
+/**\details
+ * Frees the memory used by a history
+ *
+ * \param history (the history to free)
+ */
+void history_free(History *history);
+
+#endif
@@ -2,61 +2,63 @@
  * \file   java.c
  * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
  * \version 1.0
- * \brief  Contains the java functions associated with thresher
+ * \brief  Contains the java build type associated with thresher
  *
  * \details
  * 
- * Contains the supporting functions for building java tables and parsing 
- * java buffers
+ * The build type is written as a rule file (see rules.h) and loaded at 
+ * startup.
  *
  * All commenting is designed to be compatible with Doxygen.
  */
 
 #include "java.h"
 
-void java_build_table(int *table, char *curFile) {
+const char *javaRules = 
+        "type java\n"
+        "command %c -d . %f\n"
+        "batch %c -d . %f\n"
+        "server java %s -d .\n"
+        "output stderr\n"
+        "prefix yes\n"
+        "rule 1 <identifier> expected\n"
+        "rule 2 cannot find symbol\n"
+        "rule 3 static context\n"
+        "default 4\n"
+        "label 1 missing identifier\n"
+        "label 2 missing symbol\n"
+        "label 3 non-static access\n"
+        "label 4 other\n";
 
-    // If the table value is greater than 0, print the error and the number
-    // of times the error occurred.
-    if (table[1]) {
-        printf("%d missing identifier\n", table[1]);
-    }
-    if (table[2]) {
-        printf("%d missing symbol\n", table[2]);
-    }
-    if (table[3]) {
-        printf("%d non-static access\n", table[3]);
-    }
-    if (table[4]) {
-        printf("%d other\n", table[4]);
-    }
-
-    // If the child exited normally, give the exit status. Otherwise inform
-    // the user.
-    child_exit_status(curFile, table[6]);
-}
-
-int java_parse(char **buffer, char *curFile) {
-
-    // If the buffer does not begin with "name:number":, return 0
-    if (!is_name_no(buffer, curFile)) {
-        return 0;
-    }
-
-    // Check if the buffer contains "<identifier> expected", if so return 1.
-    if (strstr(*buffer, "<identifier> expected")) {
-        return 1;
-    }
-
-    // Check if the buffer contains "cannot find symbol", if so return 2.
-    if (strstr(*buffer, "cannot find symbol")) {
-        return 2;
-    }
-
-    // Check if the buffer contains "static context", if so return 3.
-    if (strstr(*buffer, "static context")) {
-        return 3;
-    }
-
-    return 4;
-}
\ No newline at end of file
+const char *javaServerSource =
+        "import java.io.BufferedReader;\n"
+        "import java.io.InputStreamReader;\n"
+        "import java.util.ArrayList;\n"
+        "import java.util.Arrays;\n"
+        "import java.util.List;\n"
+        "import javax.tools.JavaCompiler;\n"
+        "import javax.tools.ToolProvider;\n"
+        "\n"
+        "public class ThresherServer {\n"
+        "    public static void main(String[] args) throws Exception {\n"
+        "        JavaCompiler javac =\n"
+        "                ToolProvider.getSystemJavaCompiler();\n"
+        "        BufferedReader in = new BufferedReader(\n"
+        "                new InputStreamReader(System.in));\n"
+        "        String file;\n"
+        "\n"
+        "        if (javac == null) {\n"
+        "            System.err.println(\"no Java compiler\");\n"
+        "            System.exit(1);\n"
+        "        }\n"
+        "\n"
+        "        while ((file = in.readLine()) != null) {\n"
+        "            List<String> options =\n"
+        "                    new ArrayList<>(Arrays.asList(args));\n"
+        "            options.add(file);\n"
+        "            int status = javac.run(null, null, System.err,\n"
+        "                    options.toArray(new String[0]));\n"
+        "            System.err.println(\"thresher-done \" + status);\n"
+        "        }\n"
+        "    }\n"
+        "}\n";
@@ -12,32 +12,26 @@
 #include "misc.h"
 
 /**\details
- * Builds the C table that shows what errors were encountered. 
+ * The rules for the java build type.
  * 
- * table[1]: missing identifier
- * table[2]: missing symbol
- * table[3]: non-static acecss
- * table[5]: other
+ * With --server, javaServerSource is run by the java on the PATH as the
+ * compile server (see server.h), so the JVM only starts once.
  *
- * If the child exited normally, give the exit status. Otherwise inform the 
- * user. If the child exited with a non-zero status, quit with status 5.
+ * Lines that do not begin with "name:number:" are ignored. Otherwise:
  *
- * \param table (int table of size 7)
- * \param curFile (string for the current file)
+ * table[1]: missing identifier ("<identifier> expected")
+ * table[2]: missing symbol ("cannot find symbol")
+ * table[3]: non-static acecss ("static context")
+ * table[4]: other
  */
-void java_build_table(int *table, char *curFile);
+extern const char *javaRules;
 
 /**\details
- * Parses the buffer under a set of rules, and returns a value based on a
- * set of rules.
- *
- * \param buffer (string for the current file)
- * \param curFile (string for the current file)
- * 
- * \return 0 if the buffer does not contains "name:number:"
- * \return 1 if the buffer contains "<identifier> expected"
- * \return 2 if the buffer contains "cannot find symbol"
- * \return 3 if the bufer contains "static context"
- * \return 4 otherwise
+ * The source of the java build type's compile server, run with "java file
+ * -d ." (Java 11 or later runs a source file as it is). It reads the name
+ * of each file from stdin, compiles it with javax.tools.JavaCompiler
+ * given its arguments, writing javac's lines to stderr, then writes
+ * "thresher-done status" to stderr with the status javac would have
+ * exited with.
  */
-int java_parse(char **buffer, char *curFile);
\ No newline at end of file
+extern const char *javaServerSource;
@@ -0,0 +1,476 @@
+/**
+ * \file   jsonDiag.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the reader of gcc's JSON diagnostics
+ *
+ * \details
+ *
+ * Contains the functions that split gcc's JSON output into diagnostics as
+ * it arrives, and read the kind, message, option and location of each.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include "jsonDiag.h"
+
+/**\details
+ * Terminates a buffer, without counting the terminator in its length
+ *
+ * \param buffer (the buffer, value is modified)
+ */
+static void terminate(Buffer *buffer) {
+
+    buffer_append(buffer, "", 1);
+    buffer->len--;
+}
+
+/**\details
+ * Skips white space
+ *
+ * \param p (the text)
+ *
+ * \return the first character that is not white space
+ */
+static const char *skip_space(const char *p) {
+
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+/**\details
+ * Adds a character to a buffer in UTF-8
+ *
+ * \param out (the buffer, value is modified)
+ * \param code (the character)
+ */
+static void append_utf8(Buffer *out, unsigned long code) {
+
+    char bytes[4];
+    size_t len;
+
+    if (code < 0x80) {
+        bytes[0] = (char) code;
+        len = 1;
+    } else if (code < 0x800) {
+        bytes[0] = (char) (0xc0 | (code >> 6));
+        bytes[1] = (char) (0x80 | (code & 0x3f));
+        len = 2;
+    } else if (code < 0x10000) {
+        bytes[0] = (char) (0xe0 | (code >> 12));
+        bytes[1] = (char) (0x80 | ((code >> 6) & 0x3f));
+        bytes[2] = (char) (0x80 | (code & 0x3f));
+        len = 3;
+    } else {
+        bytes[0] = (char) (0xf0 | (code >> 18));
+        bytes[1] = (char) (0x80 | ((code >> 12) & 0x3f));
+        bytes[2] = (char) (0x80 | ((code >> 6) & 0x3f));
+        bytes[3] = (char) (0x80 | (code & 0x3f));
+        len = 4;
+    }
+    buffer_append(out, bytes, len);
+}
+
+/**\details
+ * Reads the four hex digits of a \\u escape
+ *
+ * \param p (the first digit)
+ * \param code (set to the value of the digits)
+ *
+ * \return 1 if there were four hex digits, otherwise 0
+ */
+static int read_hex(const char *p, unsigned long *code) {
+
+    *code = 0;
+    for (int i = 0; i < 4; ++i) {
+        int c = p[i];
+
+        *code <<= 4;
+        if (c >= '0' && c <= '9') {
+            *code |= c - '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            *code |= (c | 0x20) - 'a' + 10;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**\details
+ * Reads a string, undoing its escapes
+ *
+ * \param p (the opening quote)
+ * \param out (buffer to add the string to, or NULL to skip it)
+ *
+ * \return the character after the closing quote, or NULL if the string is
+ * not valid
+ */
+static const char *read_string(const char *p, Buffer *out) {
+
+    const char *start;
+    unsigned long code, low;
+
+    if (*p++ != '"') {
+        return NULL;
+    }
+
+    while (*p != '"') {
+        // Copy everything up to the next escape or quote at once
+        for (start = p; *p && *p != '"' && *p != '\\'; ++p) {
+        }
+        if (out) {
+            buffer_append(out, start, p - start);
+        }
+        if (!*p) {
+            return NULL;
+        } else if (*p == '"') {
+            break;
+        }
+
+        switch (*++p) {
+            case 'b': code = '\b'; break;
+            case 'f': code = '\f'; break;
+            case 'n': code = '\n'; break;
+            case 'r': code = '\r'; break;
+            case 't': code = '\t'; break;
+            case 'u':
+                if (!read_hex(p + 1, &code)) {
+                    return NULL;
+                }
+                p += 4;
+
+                // Characters outside the first plane are surrogate pairs
+                if (code >= 0xd800 && code < 0xdc00 && p[1] == '\\'
+                        && p[2] == 'u' && read_hex(p + 3, &low)
+                        && low >= 0xdc00 && low < 0xe000) {
+                    code = 0x10000 + ((code - 0xd800) << 10)
+                            + (low - 0xdc00);
+                    p += 6;
+                }
+                break;
+            case '\0':
+                return NULL;
+            default:
+                code = (unsigned char) *p;
+                break;
+        }
+        if (out) {
+            append_utf8(out, code);
+        }
+        p++;
+    }
+
+    return p + 1;
+}
+
+/**\details
+ * Skips a value of any type
+ *
+ * \param p (the start of the value)
+ *
+ * \return the character after the value, or NULL if it is not valid
+ */
+static const char *skip_value(const char *p) {
+
+    int depth = 0;
+
+    do {
+        p = skip_space(p);
+        if (*p == '"') {
+            p = read_string(p, NULL);
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+            p++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+            p++;
+        } else if (*p == ',' || *p == ':') {
+            p++;
+        } else if (*p) {
+            // A number, true, false or null
+            p += strcspn(p, ",:]} \t\r\n\"");
+        } else {
+            return NULL;
+        }
+    } while (p && depth > 0);
+
+    return p;
+}
+
+/**\details
+ * Moves to the value of the next member of an object
+ *
+ * \param p (the '{' starting the object, or the character after the last
+ * member's value, value is modified)
+ * \param key (set to the member's name, which must have no escapes)
+ * \param keyLen (set to the length of key)
+ *
+ * \return 1 if p is now at the member's value, 0 if p is now after the end
+ * of the object, -1 if the object is not valid
+ */
+static int next_member(const char **p, const char **key, size_t *keyLen) {
+
+    const char *end;
+
+    *p = skip_space(*p);
+    if (**p == '{' || **p == ',') {
+        *p = skip_space(*p + 1);
+    }
+    if (**p == '}') {
+        (*p)++;
+        return 0;
+    }
+
+    if (**p != '"' || !(end = read_string(*p, NULL))) {
+        return -1;
+    }
+    *key = *p + 1;
+    *keyLen = end - *p - 2;
+
+    *p = skip_space(end);
+    if (**p != ':') {
+        return -1;
+    }
+    *p = skip_space(*p + 1);
+    return 1;
+}
+
+/**\details
+ * Checks the name of a member
+ *
+ * \param key (the member's name, not terminated)
+ * \param keyLen (the length of key)
+ * \param name (the name to check for)
+ *
+ * \return 1 if the member is called name, otherwise 0
+ */
+static int is_key(const char *key, size_t keyLen, const char *name) {
+
+    return strlen(name) == keyLen && !strncmp(key, name, keyLen);
+}
+
+/**\details
+ * Reads the file, line and column of the caret of a location
+ *
+ * \param p (the '{' starting the caret)
+ * \param diag (the diagnostic, value is modified)
+ *
+ * \return the character after the caret, or NULL if it is not valid
+ */
+static const char *read_caret(const char *p, JsonDiagnostic *diag) {
+
+    const char *key;
+    size_t keyLen;
+    int more;
+
+    while ((more = next_member(&p, &key, &keyLen)) == 1) {
+        if (is_key(key, keyLen, "file")) {
+            p = read_string(p, &diag->file);
+        } else if (is_key(key, keyLen, "line")) {
+            diag->line = strtol(p, NULL, 10);
+            p = skip_value(p);
+        } else if (is_key(key, keyLen, "column")) {
+            diag->column = strtol(p, NULL, 10);
+            p = skip_value(p);
+        } else {
+            p = skip_value(p);
+        }
+        if (!p) {
+            return NULL;
+        }
+    }
+
+    return more ? NULL : p;
+}
+
+/**\details
+ * Reads the caret of the first of a diagnostic's locations
+ *
+ * \param p (the '[' starting the locations)
+ * \param diag (the diagnostic, value is modified)
+ *
+ * \return the character after the locations, or NULL if they are not
+ * valid
+ */
+static const char *read_locations(const char *p, JsonDiagnostic *diag) {
+
+    const char *start = p, *key;
+    size_t keyLen;
+    int more;
+
+    p = skip_space(p + 1);
+    if (*p != '{') {
+        return skip_value(start);
+    }
+
+    while ((more = next_member(&p, &key, &keyLen)) == 1) {
+        p = is_key(key, keyLen, "caret") && !diag->file.len
+                ? read_caret(p, diag) : skip_value(p);
+        if (!p) {
+            return NULL;
+        }
+    }
+
+    return more ? NULL : skip_value(start);
+}
+
+/**\details
+ * Frees the parts of a diagnostic
+ *
+ * \param diag (the diagnostic to free)
+ */
+static void diagnostic_free(JsonDiagnostic *diag) {
+
+    free(diag->kind.data);
+    free(diag->message.data);
+    free(diag->option.data);
+    free(diag->file.data);
+}
+
+/**\details
+ * Reads a diagnostic, then gives it to found followed by its children
+ *
+ * \param p (the '{' starting the diagnostic)
+ * \param js (the stream)
+ * \param found (called with each diagnostic)
+ * \param context (passed to found)
+ *
+ * \return the character after the diagnostic, or NULL if it is not valid
+ */
+static const char *read_diagnostic(const char *p, JsonStream *js,
+        JsonDiagFn found, void *context) {
+
+    JsonDiagnostic diag;
+    const char *key, *children = NULL;
+    size_t keyLen;
+    int more;
+
+    memset(&diag, 0, sizeof(diag));
+    while ((more = next_member(&p, &key, &keyLen)) == 1) {
+        if (is_key(key, keyLen, "kind")) {
+            p = read_string(p, &diag.kind);
+        } else if (is_key(key, keyLen, "message")) {
+            p = read_string(p, &diag.message);
+        } else if (is_key(key, keyLen, "option")) {
+            p = read_string(p, &diag.option);
+        } else if (is_key(key, keyLen, "locations") && *p == '[') {
+            p = read_locations(p, &diag);
+        } else {
+            // The children are read once the diagnostic has been given
+            if (is_key(key, keyLen, "children") && *p == '[') {
+                children = p;
+            }
+            p = skip_value(p);
+        }
+        if (!p) {
+            break;
+        }
+    }
+
+    if (!more) {
+        terminate(&diag.kind);
+        terminate(&diag.message);
+        terminate(&diag.option);
+        terminate(&diag.file);
+        found(context, &diag);
+    }
+
+    diagnostic_free(&diag);
+
+    if (more) {
+        return NULL;
+    }
+
+    // Then the notes and such that belong to it, in order
+    if (children) {
+        children = skip_space(children + 1);
+        while (*children == '{') {
+            if (!(children = read_diagnostic(children, js, found,
+                    context))) {
+                break;
+            }
+            children = skip_space(children);
+            children = skip_space(children + (*children == ','));
+        }
+    }
+
+    return p;
+}
+
+void json_init(JsonStream *js) {
+
+    memset(js, 0, sizeof(JsonStream));
+}
+
+void json_feed(JsonStream *js, const char *data, size_t len,
+        JsonDiagFn found, void *context) {
+
+    const char *start = data, *end = data + len, *copy;
+
+    // Text outside the diagnostics is passed on as a line of its own
+    if (js->depth == 0) {
+        while (start < end && (*start == ' ' || *start == '\t')) {
+            start++;
+        }
+        if (start == end || *start != '[') {
+            JsonDiagnostic text;
+
+            memset(&text, 0, sizeof(text));
+            buffer_append(&text.message, data, len);
+            terminate(&text.kind);
+            terminate(&text.message);
+            terminate(&text.option);
+            terminate(&text.file);
+            found(context, &text);
+            diagnostic_free(&text);
+            return;
+        }
+    }
+
+    // Copy each diagnostic's text a span at a time, not a character
+    copy = js->depth >= 2 ? start : NULL;
+    for (const char *p = start; p < end; ++p) {
+        char c = *p;
+
+        if (js->inString) {
+            if (js->escaped) {
+                js->escaped = 0;
+            } else if (c == '\\') {
+                js->escaped = 1;
+            } else if (c == '"') {
+                js->inString = 0;
+            }
+        } else if (c == '"') {
+            js->inString = 1;
+        } else if (c == '[' || c == '{') {
+            // A diagnostic starts at the second level
+            if (++js->depth == 2) {
+                js->element.len = 0;
+                copy = p;
+            }
+        } else if ((c == ']' || c == '}') && js->depth > 0
+                && --js->depth == 1) {
+            buffer_append(&js->element, copy, p + 1 - copy);
+            buffer_append(&js->element, "", 1);
+            if (*js->element.data == '{') {
+                read_diagnostic(js->element.data, js, found, context);
+            }
+            copy = NULL;
+        }
+    }
+
+    // Keep the rest of the diagnostic, with a space for the newline
+    if (copy) {
+        buffer_append(&js->element, copy, end - copy);
+        buffer_append(&js->element, " ", 1);
+    }
+}
+
+void json_free(JsonStream *js) {
+
+    free(js->element.data);
+    json_init(js);
+}
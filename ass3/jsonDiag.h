@@ -0,0 +1,86 @@
+/**
+ * \file   jsonDiag.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for jsonDiag.c
+ *
+ * \details
+ *
+ * gcc -fdiagnostics-format=json prints an array of diagnostics such as
+ *
+ *     [{"kind": "error", "message": "'x' undeclared ...",
+ *       "locations": [{"caret": {"file": "a.c", "line": 1, "column": 28}}],
+ *       "children": [{"kind": "note", ...}], ...}, ...]
+ *
+ * Each diagnostic, and then each of its children, is read into its kind,
+ * message, option and the caret of its first location, so it can be
+ * classified by its kind and message rather than by the text gcc would
+ * have printed for it.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef JSON_DIAG_H
+#define JSON_DIAG_H
+
+#include "misc.h"
+
+/** \struct JsonDiagnostic
+ *  \brief The parts of one diagnostic, each terminated. A line of text
+ *          outside the diagnostics has an empty kind and the line as its
+ *          message.
+ */
+typedef struct {
+    Buffer kind;            /**< "error", "warning", "note" ... */
+    Buffer message;         /**< The message */
+    Buffer option;          /**< The option that enabled it, if any */
+    Buffer file;            /**< The file of its first location, if any */
+    long line;              /**< The line of its first location */
+    long column;            /**< The column of its first location */
+} JsonDiagnostic;
+
+/** \struct JsonStream
+ *  \brief Splits a stream of JSON diagnostics into one diagnostic at a time
+ */
+typedef struct {
+    Buffer element;         /**< The text of the diagnostic being read */
+    int depth;              /**< How deeply nested the text being read is */
+    int inString;           /**< Boolean for being inside a string */
+    int escaped;            /**< Boolean for the last character being '\' */
+} JsonStream;
+
+//! Called with each diagnostic, only valid until it returns
+typedef void (*JsonDiagFn)(void *context, JsonDiagnostic *diag);
+
+/**\details
+ * Sets up an empty stream
+ *
+ * \param js (the stream to set up, value is modified)
+ */
+void json_init(JsonStream *js);
+
+/**\details
+ * Reads the next line of the compiler's output
+ *
+ * Add the line to the diagnostic being read. Each time a diagnostic ends,
+ * call found with it and then with its children, in order. A line outside
+ * of any array (such as the linker's errors) is passed to found as the
+ * message of a diagnostic with no kind.
+ *
+ * \param js (the stream, value is modified)
+ * \param data (the line, without its newline)
+ * \param len (the length of the line)
+ * \param found (called with each diagnostic)
+ * \param context (passed to found)
+ */
+void json_feed(JsonStream *js, const char *data, size_t len,
+        JsonDiagFn found, void *context);
+
+/**\details
+ * Frees the memory used by a stream
+ *
+ * \param js (the stream to free)
+ */
+void json_free(JsonStream *js);
+
+#endif
@@ -0,0 +1,328 @@
+/**
+ * \file   logs.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the offline log summarisation used by thresher
+ *
+ * \details
+ *
+ * Contains the functions that summarise existing compiler logs into the
+ * same tables thresher would print after running the compiler, with the
+ * logs split across threads.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "logs.h"
+
+/**\details
+ * Compares two file names for qsort
+ *
+ * \param a (pointer to the first name)
+ * \param b (pointer to the second name)
+ *
+ * \return the order of the names, as strcmp
+ */
+static int compare_names(const void *a, const void *b) {
+
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+/**\details
+ * Gets the contents of an open log, mapping a regular file and reading
+ * anything else in
+ *
+ * \param fd (the open log)
+ * \param info (the log's fstat)
+ * \param piped (holds what was read if the log is not mapped, value is
+ * modified)
+ * \param size (set to the size of the log)
+ *
+ * \return the contents of the log, quitting with ERR_LOG if they cannot be
+ * mapped
+ */
+static const char *map_log(int fd, struct stat *info, Buffer *piped,
+        size_t *size) {
+
+    const char *data;
+
+    // Map regular files, anything else has to be read in
+    if (S_ISREG(info->st_mode)) {
+        *size = info->st_size;
+        data = *size ? (const char *) mmap(NULL, *size, PROT_READ,
+                MAP_PRIVATE, fd, 0) : NULL;
+        if (data == MAP_FAILED) {
+            quit(ERR_LOG, 0);
+        }
+        if (*size) {
+            madvise((void *) data, *size, MADV_SEQUENTIAL);
+        }
+    } else {
+        char chunk[65536];
+        ssize_t count;
+
+        while ((count = read(fd, chunk, sizeof(chunk))) > 0) {
+            buffer_append(piped, chunk, count);
+        }
+        data = piped->data;
+        *size = piped->len;
+    }
+
+    return data;
+}
+
+/**\details
+ * Releases the contents of a log given by map_log
+ *
+ * \param info (the log's fstat)
+ * \param data (the contents of the log)
+ * \param piped (what was read, if the log was not mapped)
+ * \param size (the size of the log)
+ */
+static void unmap_log(struct stat *info, const char *data, Buffer *piped,
+        size_t size) {
+
+    if (S_ISREG(info->st_mode) && size) {
+        munmap((void *) data, size);
+    }
+    free(piped->data);
+}
+
+void log_run(ThresherStruct *ts, char **files, int numFiles) {
+
+    int numThreads = ts->jobs;
+    char **sorted = (char **) malloc(sizeof(char *) * numFiles);
+    int *tables = (int *) calloc(numFiles * NUM_CATEGORIES, sizeof(int));
+    LogChunk *chunks;
+
+    if (numThreads < 1) {
+        numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = numThreads < 1 ? 1 : numThreads;
+    }
+    chunks = (LogChunk *) malloc(sizeof(LogChunk) * numThreads);
+
+    // Without a prefix, lines can only be matched to files by position
+    if (!ts->build->prefix && ts->numLogs != numFiles) {
+        quit(ERR_USAGE, 0);
+    }
+
+    // Sort the names so each line's name can be found with a binary search
+    memcpy(sorted, files, sizeof(char *) * numFiles);
+    qsort(sorted, numFiles, sizeof(char *), compare_names);
+
+    for (int i = 0; i < ts->numLogs; ++i) {
+        int fd = strcmp(ts->logs[i], "-") ? open(ts->logs[i], O_RDONLY)
+                : STDIN_FILENO;
+        Buffer piped = {NULL, 0, 0};
+        const char *data, *start, *end;
+        struct stat info;
+        size_t size;
+
+        if (fd == -1 || fstat(fd, &info) == -1) {
+            quit(ERR_LOG, 0);
+        }
+
+        data = map_log(fd, &info, &piped, &size);
+
+        // Split the log into a chunk per thread, moving each split to the
+        // start of the next line
+        start = data;
+        end = data + size;
+        for (int j = 0; j < numThreads; ++j) {
+            const char *split = data + size / numThreads * (j + 1);
+
+            if (j == numThreads - 1 || split >= end) {
+                split = end;
+            } else if (split > start) {
+                const char *newline = (const char *) memchr(split - 1,
+                        '\n', end - split + 1);
+                split = newline ? newline + 1 : end;
+            } else {
+                split = start;
+            }
+
+            chunks[j].build = ts->build;
+            chunks[j].start = start;
+            chunks[j].end = split;
+            chunks[j].sorted = sorted;
+            chunks[j].numFiles = numFiles;
+            chunks[j].fixedFile = ts->build->prefix ? -1 : log_find_file(
+                    sorted, numFiles, files[i], strlen(files[i]));
+            chunks[j].tables = (int *) calloc(numFiles * NUM_CATEGORIES,
+                    sizeof(int));
+            chunks[j].top = ts->top;
+            chunks[j].untilQuit = 0;
+            diag_init(&chunks[j].diags);
+            pthread_create(&chunks[j].thread, NULL, log_thread, &chunks[j]);
+
+            start = split;
+        }
+
+        // Add each thread's tables to the totals
+        for (int j = 0; j < numThreads; ++j) {
+            pthread_join(chunks[j].thread, NULL);
+            for (int k = 0; k < numFiles * NUM_CATEGORIES; ++k) {
+                tables[k] += chunks[j].tables[k];
+            }
+            free(chunks[j].tables);
+            diag_merge(&ts->diags, &chunks[j].diags);
+            diag_free(&chunks[j].diags);
+        }
+
+        unmap_log(&info, data, &piped, size);
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+    }
+
+    // Print the tables in the order the files were given
+    for (int i = 0; i < numFiles; ++i) {
+        int index = log_find_file(sorted, numFiles, files[i],
+                strlen(files[i]));
+
+        if (outputFormat != FORMAT_TEXT) {
+            int table[7];
+
+            memcpy(table, &tables[index * NUM_CATEGORIES], 
+                    sizeof(int) * NUM_CATEGORIES);
+            report_record(ts->build, table, files[i], NULL, 0, NULL);
+            continue;
+        }
+
+        printf("----\n");
+        rules_print_table(ts->build, &tables[index * NUM_CATEGORIES]);
+        printf("----\n");
+    }
+
+    if (ts->top) {
+        diag_print_top(&ts->diags, ts->top);
+    }
+
+    free(chunks);
+    free(tables);
+    free(sorted);
+}
+
+void log_count(ThresherStruct *ts, const char *path, int table[]) {
+
+    int fd = open(path, O_RDONLY);
+    Buffer piped = {NULL, 0, 0};
+    LogChunk chunk;
+    struct stat info;
+    size_t size;
+
+    // A compiler that never started has written no log
+    if (fd == -1) {
+        return;
+    }
+    if (fstat(fd, &info) == -1) {
+        quit(ERR_LOG, 0);
+    }
+
+    // One file and one chunk, counted without a thread
+    chunk.build = ts->build;
+    chunk.start = map_log(fd, &info, &piped, &size);
+    chunk.end = chunk.start + size;
+    chunk.sorted = &ts->curFile;
+    chunk.numFiles = 1;
+    chunk.fixedFile = 0;
+    chunk.tables = table;
+    chunk.top = ts->top;
+    chunk.untilQuit = 1;
+    diag_init(&chunk.diags);
+    log_thread(&chunk);
+
+    diag_merge(&ts->diags, &chunk.diags);
+    diag_free(&chunk.diags);
+    unmap_log(&info, chunk.start, &piped, size);
+    close(fd);
+}
+
+void *log_thread(void *arg) {
+
+    LogChunk *chunk = (LogChunk *) arg;
+    BuildType *bt = chunk->build;
+    const char *line, *next, *colon, *end;
+    int file, rule, category;
+
+    for (line = chunk->start; line < chunk->end; line = next) {
+
+        // Find the end of the line
+        end = (const char *) memchr(line, '\n', chunk->end - line);
+        if (!end) {
+            end = chunk->end;
+        }
+        next = end + 1;
+
+        // Find the file the line belongs to: "name:num:" with every
+        // character of num a number
+        if (bt->prefix) {
+            colon = (const char *) memchr(line, ':', end - line);
+            file = log_find_file(chunk->sorted, chunk->numFiles, line,
+                    (colon ? colon : end) - line);
+            if (file == -1) {
+                continue;
+            }
+            for (colon = colon ? colon + 1 : end; colon < end
+                    && *colon != ':'; ++colon) {
+                if (*colon < 48 || *colon > 57) {
+                    file = -1;
+                    break;
+                }
+            }
+            if (file == -1) {
+                continue;
+            }
+        } else {
+            file = chunk->fixedFile;
+        }
+
+        rule = rules_match(bt, line, end - line);
+        category = rule == -1 ? bt->fallback : bt->rules[rule].category;
+        chunk->tables[file * NUM_CATEGORIES + category]++;
+
+        if (chunk->top && bt->labels[category]) {
+            diag_add_line(&chunk->diags, bt, line, end - line, 
+                    chunk->sorted[file]);
+        }
+
+        // The reply would have ended the run here
+        if (chunk->untilQuit && rule != -1 && bt->rules[rule].reply
+                && bt->rules[rule].reply[0] == 'X') {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+int log_find_file(char **sorted, int numFiles, const char *name,
+        size_t len) {
+
+    int low = 0, high = numFiles, mid, order;
+
+    // Find the first name that is not less than name
+    while (low < high) {
+        mid = (low + high) / 2;
+        order = strncmp(sorted[mid], name, len);
+        if (order == 0 && sorted[mid][len] != '\0') {
+            order = 1;
+        }
+        if (order < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < numFiles && !strncmp(sorted[low], name, len)
+            && sorted[low][len] == '\0' && len > 0) {
+        return low;
+    }
+
+    return -1;
+}
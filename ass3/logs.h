@@ -0,0 +1,105 @@
+/**
+ * \file   logs.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for logs.c
+ *
+ * \details
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef LOGS_H
+#define LOGS_H
+
+#include <pthread.h>
+
+#include "thresherSupport.h"
+
+/** \struct LogChunk
+ *  \brief Creates a structure that holds the part of a log one thread
+ *          summarises and the tables it builds
+ */
+typedef struct {
+    BuildType *build;       /**< The build type of the log */
+    const char *start;      /**< The first byte of the chunk */
+    const char *end;        /**< One past the last byte of the chunk */
+    char **sorted;          /**< The file names in sorted order */
+    int numFiles;           /**< The number of file names */
+    int fixedFile;          /**< Sorted index every line counts towards if
+                                 the build type has no prefix, else -1 */
+    int *tables;            /**< NUM_CATEGORIES counts for each sorted file */
+    int top;                /**< Boolean for counting diagnostics */
+    int untilQuit;          /**< Boolean for stopping after a line whose
+                                 rule's reply ends the run */
+    DiagTable diags;        /**< The diagnostics counted, if top is set */
+    pthread_t thread;       /**< The thread ID */
+} LogChunk;
+
+/**\details
+ * Summarises compiler logs rather than running the compiler.
+ *
+ * Each log is memory-mapped (or read, if it is a pipe) and split at line
+ * boundaries into one chunk per thread (ts->jobs, or one per core if not
+ * given). Each thread counts its lines into tables for the files, and the
+ * tables are added together. For build types with a prefix, a line counts
+ * towards the file whose name starts it, as is_name_no would check. For
+ * build types without one (like latex), the nth log counts towards the nth
+ * file. Finally, print each file's table in the order the files were
+ * given, or their records if outputFormat is not FORMAT_TEXT. If ts->top
+ * is set, each thread also counts the diagnostics in its chunk, and the
+ * most common ones across every log are printed last. There is no exit 
+ * status to report.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param files (string array of the files to summarise)
+ * \param numFiles (the number of files)
+ */
+void log_run(ThresherStruct *ts, char **files, int numFiles);
+
+/**\details
+ * Counts the log a compiler run without replies (--nonstop) wrote for
+ * ts->curFile.
+ *
+ * The log is read in one go once the compiler has finished, in a single
+ * chunk, and every line counts towards ts->curFile. The count stops after
+ * a line whose rule's reply would have ended an interactive run ("X"), so
+ * the table is the one the interactive run would have given. If ts->top
+ * is set, the diagnostics are counted in ts->diags. If there is no log,
+ * nothing is counted.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param path (the path of the log)
+ * \param table (int table of size 7, value is added to by the function)
+ */
+void log_count(ThresherStruct *ts, const char *path, int table[]);
+
+/**\details
+ * Counts the lines of one chunk of a log.
+ *
+ * Find each line with memchr and work out which file it belongs to. Skip
+ * lines that belong to none of the files, and count the rest in the
+ * category of the first rule they match (or the fallback category). If
+ * top is set, count lines in a labelled category in the chunk's diags. If
+ * untilQuit is set, stop after a line whose rule replies with "X".
+ *
+ * \param arg (pointer to a LogChunk, its tables are modified)
+ *
+ * \return NULL
+ */
+void *log_thread(void *arg);
+
+/**\details
+ * Finds the first of the sorted file names equal to a name.
+ *
+ * \param sorted (the file names in sorted order)
+ * \param numFiles (the number of file names)
+ * \param name (the name to look for, not terminated)
+ * \param len (the length of name)
+ *
+ * \return the index in sorted of the name
+ * \return -1 if the name is not there
+ */
+int log_find_file(char **sorted, int numFiles, const char *name, size_t len);
+
+#endif
@@ -7,8 +7,153 @@
  * All commenting is designed to be compatible with Doxygen.
  */
 
+#include <fcntl.h>
+
 #include "misc.h"
 
+int jobTokens[2] = {-1, -1};
+
+int outputFormat = FORMAT_TEXT;
+
+/** The token held by this process, or -1 if none is held */
+static int tokenHeld = -1;
+
+/** Where the held token goes back to */
+static int tokenSource = -1;
+
+/** Pipe holding the token make gave thresher itself, both ends -1 if 
+ *  jobTokens is not make's jobserver */
+static int implicitToken[2] = {-1, -1};
+
+void buffer_append(Buffer *buf, const char *data, size_t len) {
+
+    // Double the size of the buffer until the data fits
+    if (buf->len + len > buf->size) {
+        while (buf->len + len > buf->size) {
+            buf->size = buf->size ? buf->size * 2 : 4096;
+        }
+        buf->data = (char *) realloc(buf->data, buf->size);
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+/**\details
+ * Finds the jobserver in MAKEFLAGS, the last --jobserver-auth (or the
+ * older --jobserver-fds) given
+ *
+ * \param flags (the value of MAKEFLAGS)
+ *
+ * \return the value of the option, free with free(), or NULL if there is
+ * none
+ */
+static char *jobserver_auth(const char *flags) {
+
+    const char *options[] = {"--jobserver-auth=", "--jobserver-fds="};
+    const char *found = NULL, *p;
+
+    for (int i = 0; i < 2; ++i) {
+        for (p = strstr(flags, options[i]); p; 
+                p = strstr(p + 1, options[i])) {
+            if (p > found) {
+                found = p + strlen(options[i]);
+            }
+        }
+    }
+
+    return found ? strndup(found, strcspn(found, " ")) : NULL;
+}
+
+void token_jobserver(void) {
+
+    char *flags = getenv("MAKEFLAGS"), *auth;
+    int fds[2];
+
+    if (!flags || jobTokens[READ] != -1 || !(auth = jobserver_auth(flags))) {
+        return;
+    }
+
+    // Newer makes give a named pipe, older ones the descriptors of a pipe
+    // that are only open if the recipe was marked as running make
+    if (!strncmp(auth, "fifo:", 5)) {
+        fds[READ] = fds[WRITE] = open(auth + 5, O_RDWR | O_CLOEXEC);
+    } else if (sscanf(auth, "%d,%d", &fds[READ], &fds[WRITE]) != 2
+            || fcntl(fds[READ], F_GETFD) == -1 
+            || fcntl(fds[WRITE], F_GETFD) == -1) {
+        fds[READ] = -1;
+    }
+    free(auth);
+
+    // Every recipe may run one job without a token, so keep that one in a
+    // pipe of thresher's own that workers share
+    if (fds[READ] == -1 || pipe(implicitToken)
+            || fcntl(implicitToken[READ], F_SETFD, FD_CLOEXEC)
+            || fcntl(implicitToken[WRITE], F_SETFD, FD_CLOEXEC)
+            || fcntl(implicitToken[READ], F_SETFL, O_NONBLOCK)
+            || write(implicitToken[WRITE], "+", 1) != 1) {
+        return;
+    }
+
+    jobTokens[READ] = fds[READ];
+    jobTokens[WRITE] = fds[WRITE];
+}
+
+void token_acquire(void) {
+
+    struct pollfd fds[2];
+    unsigned char token;
+    ssize_t count;
+
+    if (jobTokens[READ] == -1) {
+        return;
+    }
+
+    // Use thresher's own token if it is free, otherwise wait for either it
+    // or one from make. Another process may take make's token first, in 
+    // which case the read waits for the next one.
+    fds[0].fd = implicitToken[READ];
+    fds[1].fd = jobTokens[READ];
+    fds[0].events = fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    while (implicitToken[READ] != -1) {
+        if (read(implicitToken[READ], &token, 1) == 1) {
+            tokenHeld = token;
+            tokenSource = implicitToken[WRITE];
+            return;
+        }
+        if (poll(fds, 2, -1) == -1 && errno != EINTR) {
+            quit(ERR_SYS, 0);
+        }
+        if (fds[1].revents) {
+            break;
+        }
+    }
+
+    // Wait for another process to give a token back
+    while ((count = read(jobTokens[READ], &token, 1)) == -1 
+            && errno == EINTR) {
+    }
+    if (count != 1) {
+        quit(ERR_SYS, 0);
+    }
+    tokenHeld = token;
+    tokenSource = jobTokens[WRITE];
+}
+
+void token_release(void) {
+
+    unsigned char token = (unsigned char) tokenHeld;
+
+    if (tokenHeld == -1) {
+        return;
+    }
+
+    tokenHeld = -1;
+    while (write(tokenSource, &token, 1) == -1 && errno == EINTR) {
+    }
+}
+
 void child_exit_status(char *curFile, int status) {
     
     // If the child exited normally, give the exit status. Otherwise inform
@@ -35,82 +180,149 @@ void child_quit(FILE *errPipe, int status) {
 
 int is_name_no(char **buffer, char *curFile) {
     
-    char *file, *num;
-    int isNum = 1;
-    int isFile = 0;
-
-    // Allocate memory for both the file and the num string, both of which
-    // have the potentional to take up the entire buffer.
-    file = (char *) malloc(sizeof(char) * strlen(*buffer));
-    num = (char *) malloc(sizeof(char) * strlen(*buffer));
-
-    // Use sscanf to extract te file and the num 
-    // %[^:] indicates a string that does not contain ":"
-    sscanf(*buffer, "%[^:]:%[^:]:", file, num);
-
-    // Iterate throw the num string and check that all characters in
-    // the string were numbers
-    for (int i = 0; i < strlen(num); ++i) {
-        if (num[i] < 48 || num[i] > 57) {
-            isNum = 0;
-            break;
-        }
+    size_t fileLen = strlen(curFile);
+    char *num;
+
+    // The buffer must start with the file name, followed by ':' or the end
+    // of the buffer. A name containing ':' can never match.
+    if (strncmp(*buffer, curFile, fileLen) || strchr(curFile, ':')
+            || ((*buffer)[fileLen] != ':' && (*buffer)[fileLen] != '\0')
+            || fileLen == 0) {
+        return 0;
     }
 
-    // Check if the file name grabbed from the buffer is the same as the
-    // filename given in the argument
-    isFile = !strcmp(curFile, file);
+    // Iterate through the num string (up to the next ':') and check that all
+    // characters in the string were numbers
+    num = *buffer + fileLen + ((*buffer)[fileLen] == ':');
+    for (; *num && *num != ':'; ++num) {
+        if (*num < 48 || *num > 57) {
+            return 0;
+        }
+    }
 
-    free(file);
-    free(num);
-    
     // If the file name is the same and the num string is actually a number
     // return true
-    return (isNum && isFile);
-
+    return 1;
 }
 
-int get_line(char **buffer, FILE *input) { 
-   
-    int c, count;
-    char *tempBuffer = (char *) malloc(sizeof(char)*1);
+void reader_init(LineReader *reader, int fd) {
+
+    reader->fd = fd;
+    reader->size = 65536;
+    reader->data = (char *) malloc(reader->size);
+    reader->start = 0;
+    reader->end = 0;
+    reader->scanned = 0;
+    reader->eof = 0;
+}
 
-    count = 0;
+int reader_next(LineReader *reader, char **buffer, size_t *len) {
 
-    // Run while there are still characters to get
-    while ((c = fgetc(input)) > 0) {
-        
-        // Reallocate the buffer and increase its size by 1
-        tempBuffer = (char *) realloc(tempBuffer, 
-                sizeof(char) * (strlen(tempBuffer) + 1));
+    char *newline;
+    ssize_t count;
 
-        // Assign the character read to the buffer
-        tempBuffer[count] = c;
+    while (1) {
+        // Look for the end of the line in what has not been searched yet
+        newline = (char *) memchr(reader->data + reader->scanned, '\n',
+                reader->end - reader->scanned);
 
-        // If the string is done, set the buffer
-        if (c == '\n' || c == '\0') {
-            tempBuffer[count] = '\0';
+        if (newline || (reader->eof && reader->start < reader->end)) {
+            if (!newline) {
+                // The last line has no newline, there is always a spare
+                // byte at the end of the buffer to terminate it.
+                newline = reader->data + reader->end;
+            }
 
-            *buffer = tempBuffer;
+            *newline = '\0';
+            *buffer = reader->data + reader->start;
+            if (len) {
+                *len = newline - *buffer;
+            }
 
+            reader->start = reader->scanned = newline - reader->data + 1;
+            if (reader->start > reader->end) {
+                reader->start = reader->scanned = reader->end;
+            }
             return 1;
         }
 
-        count++;
+        if (reader->eof) {
+            return 0;
+        }
+
+        reader->scanned = reader->end;
+
+        // Move the partial line to the front of the buffer, and double the
+        // buffer if the partial line fills it.
+        if (reader->start > 0) {
+            memmove(reader->data, reader->data + reader->start, 
+                    reader->end - reader->start);
+            reader->end -= reader->start;
+            reader->scanned -= reader->start;
+            reader->start = 0;
+        }
+        if (reader->end + 1 >= reader->size) {
+            reader->size *= 2;
+            reader->data = (char *) realloc(reader->data, reader->size);
+        }
+
+        count = read(reader->fd, reader->data + reader->end, 
+                reader->size - reader->end - 1);
+
+        if (count > 0) {
+            reader->end += count;
+        } else if (count == -1 && errno == EINTR) {
+            continue;
+        } else if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return -1;
+        } else {
+            reader->eof = 1;
+        }
     }
+}
 
-    free(tempBuffer);
+void reader_free(LineReader *reader) {
 
-    return 0;
+    free(reader->data);
+    reader->data = NULL;
+}
+
+int get_num_arg(char *arg, int *num) {
+
+    char c;
+
+    // The argument must be a number and nothing else
+    return (sscanf(arg, "%d%c", num, &c) == 1 && *num > 0);
 }
 
 void quit(int status, int printLines) {
 
+    // Don't take a token with us
+    token_release();
+
     // Print the message corresponding to the exit status given
     switch (status) {
         case ERR_USAGE:
-            fprintf(stderr, "Usage: thresher [--show] type command "\
-                    "filename ...\n");
+            fprintf(stderr, "Usage: thresher [--show] [--fork] [--watch] "\
+                    "[--top num] [-j jobs]\n"\
+                    "                [--rules file] [--format json|csv] "\
+                    "[--batch num]\n"\
+                    "                [--json-diagnostics] "\
+                    "[--syntax-only | --verify-syntax]\n"\
+                    "                [--nonstop] [--server] "\
+                    "[--max-errors num | --fail-fast]\n"\
+                    "                [--history file] [--timeout secs] "\
+                    "[--cpu-limit secs]\n"\
+                    "                [--mem-limit MB] "\
+                    "[--cache dir [--cache-size MB]]\n"\
+                    "                type command filename ...\n"\
+                    "       thresher [-j threads] [--rules file] "\
+                    "[--format json|csv] [--top num]\n"\
+                    "                --log logfile ... type filename ...\n"\
+                    "       thresher --daemon socket [-j jobs] "\
+                    "[--rules file]\n"\
+                    "       thresher --connect socket [options] type "\
+                    "command filename ...\n");
             break;
         case ERR_UNKNOWN:
             fprintf(stderr, "Unknown build type\n");
@@ -121,10 +333,16 @@ void quit(int status, int printLines) {
         case ERR_SYS:
             fprintf(stderr, "System error\n");
             break;
+        case ERR_RULES:
+            fprintf(stderr, "Bad rule file\n");
+            break;
+        case ERR_LOG:
+            fprintf(stderr, "Bad log file\n");
+            break;
     }
 
-    // Print the remaining lines of dashes
-    for (int i = 0; i < printLines; ++i) {
+    // Print the remaining lines of dashes, which only tables have
+    for (int i = 0; i < printLines && outputFormat == FORMAT_TEXT; ++i) {
         printf("----\n");
     }
 
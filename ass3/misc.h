@@ -9,6 +9,12 @@
  * All commenting is designed to be compatible with Doxygen.
  */
 
+#ifndef MISC_H
+#define MISC_H
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,6 +35,83 @@
 #define ERR_EXEC 3
 #define ERR_SYS 4
 #define ERR_NONZERO 5
+#define ERR_RULES 6
+#define ERR_LOG 7
+
+//! The status a pool worker quits with when its compiler was stopped (by
+//! --max-errors or a limit), which the pool quits with as ERR_NONZERO
+#define ERR_STOPPED 8
+
+#define FORMAT_TEXT 0
+#define FORMAT_JSON 1
+#define FORMAT_CSV 2
+
+//! Global var. Pipe holding a byte for each compiler that may run at once,
+//! both ends -1 if there is no limit.
+extern int jobTokens[2];
+
+//! Global var. The format files are reported in, FORMAT_TEXT for tables.
+extern int outputFormat;
+
+/** \struct Buffer
+ *  \brief A block of bytes that grows as data is appended to it
+ */
+typedef struct {
+    char *data;             /**< The bytes held, NULL if none */
+    size_t len;             /**< The number of bytes held */
+    size_t size;            /**< The number of bytes allocated */
+} Buffer;
+
+/** \struct LineReader
+ *  \brief Reads lines from a file descriptor in large chunks
+ */
+typedef struct {
+    int fd;                 /**< The file descriptor to read from */
+    char *data;             /**< The chunk buffer, reused for every line */
+    size_t size;            /**< The number of bytes allocated */
+    size_t start;           /**< Offset of the first unread byte */
+    size_t end;             /**< Offset one past the last byte read */
+    size_t scanned;         /**< Offset up to which there is no newline */
+    int eof;                /**< Boolean for the end of input being read */
+} LineReader;
+
+/**\details
+ * Appends len bytes of data to the end of buf
+ * 
+ * If the buffer is too small, double its size until the data fits.
+ *
+ * \param buf (the buffer to append to, value is modified)
+ * \param data (the bytes to append)
+ * \param len (the number of bytes to append)
+ */
+void buffer_append(Buffer *buf, const char *data, size_t len);
+
+/**\details
+ * Uses GNU make's jobserver for jobTokens, if thresher is run by make -j
+ *
+ * If MAKEFLAGS has --jobserver-auth=R,W (with both descriptors open) or
+ * --jobserver-auth=fifo:path, and jobTokens is not already set, set 
+ * jobTokens to the jobserver's pipe. Keep the token make gives each recipe
+ * in a pipe of thresher's own, so one compiler can always run.
+ */
+void token_jobserver(void);
+
+/**\details
+ * Takes a token from jobTokens before a compiler is started
+ * 
+ * Block until a byte can be read from jobTokens (or thresher's own token
+ * is free, under make's jobserver). If there is no limit, return straight
+ * away.
+ */
+void token_acquire(void);
+
+/**\details
+ * Gives back the token taken by token_acquire once the compiler is reaped
+ * 
+ * If no token is held, do nothing. quit() calls this so a token is never
+ * lost when thresher quits early.
+ */
+void token_release(void);
 
 /**\details
  * Generates the childs exit status
@@ -56,9 +139,9 @@ void child_quit(FILE *errPipe, int status);
 /**\details
  * Checks if the buffer starts with "name:num:"
  * 
- * Allocate strings for both the file and the num, and read them from 
- * the buffer. If the num is a number and the name matches curFile, return
- * 'true'. Otherwise return 0.
+ * Compare the start of the buffer with curFile, then check that the field 
+ * after it (up to the next ':') is a number. This is done in place, without
+ * copying either field out of the buffer.
  *
  * \param buffer (string containing the last read line from the child)
  * \param curFile (string for the current file) 
@@ -69,38 +152,70 @@ void child_quit(FILE *errPipe, int status);
 int is_name_no(char **buffer, char *curFile);
 
 /**\details
- * Get the next line from the buffer
+ * Sets up a line reader for a file descriptor
  * 
- * Create the temp buffer, and start a loop that runs while there is still
- * characters to read from the buffer (if this loop fails, return 0). For each
- * character read, reallocate and increase the size of the buffer by 1 and add
- * the character to the end of the string.
- *
- * If newline or endstring is reached, create the buffer, free the tempbuffer
- * and return 1.
+ * \param reader (the reader to set up, value is modified by the function)
+ * \param fd (the file descriptor to read lines from)
+ */
+void reader_init(LineReader *reader, int fd);
+
+/**\details
+ * Get the next line from the reader
+ * 
+ * Look for a newline in the unread part of the reader's buffer with memchr.
+ * If there is none, move the unread part to the front of the buffer 
+ * (doubling the buffer if it is full), read as much as will fit and look
+ * again. The newline is replaced with '\0' and the line is handed out in 
+ * place, so it is only valid until the next call. A last line without a
+ * newline is still handed out.
  *
- * \param buffer (pointer to a char, value is modified by the function)
- * \param input (file pointer to the input to read into buffer) 
+ * \param reader (the reader to read from, value is modified)
+ * \param buffer (pointer to a char, set to the line read)
+ * \param len (set to the length of the line, may be NULL)
  *
  * \return 1 if the line has been read
  * \return 0 if there are no more lines to be read
+ * \return -1 if the file descriptor is non-blocking and has no full line
  */
-int get_line(char **buffer, FILE *input);
+int reader_next(LineReader *reader, char **buffer, size_t *len);
+
+/**\details
+ * Frees the memory used by a line reader. The file descriptor is left open.
+ * 
+ * \param reader (the reader to free)
+ */
+void reader_free(LineReader *reader);
+
+/**\details
+ * Reads a positive number from an argument
+ * 
+ * \param arg (string containing the argument)
+ * \param num (int read from the argument, value is modified)
+ *
+ * \return 1 if arg is a positive number
+ * \return 0 otherwise
+ */
+int get_num_arg(char *arg, int *num);
 
 /**\details
  * Throw a message and quit the program
  * 
  * Throw a message to stderr corresponding to the status given
- * 1. Usage: thresher [--show] type command filename ...
+ * 1. Usage: thresher [--show] [-j jobs] [--rules file] type command 
+ *    filename ... (or the --log form)
  * 2. Unknown build type
  * 3. Exec failed
  * 4. System error
+ * 6. Bad rule file
+ * 7. Bad log file
  *
- * Print the required amount of lines of dashes given by printLines, and
- * exit with status.
+ * Print the required amount of lines of dashes given by printLines (none
+ * unless outputFormat is FORMAT_TEXT), and exit with status.
  *
  * \param status (int denoting status to quit with)
  * \param printLines (an int indicating the number of lines of dashes to be
  * printed) 
  */
-void quit(int status, int printLines);
\ No newline at end of file
+void quit(int status, int printLines);
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * \file   parseBench.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Measures how quickly thresher parses compiler output
+ *
+ * \details
+ *
+ * Usage: parseBench [type] [lines] [runs] [compiler]
+ *
+ * Run compiler (default ./fakeCompiler) once for a file of the build type
+ * (default ansiC) with $FAKECC_LINES set to lines (default 100000), and
+ * save what it prints. Then parse the saved output with parse_child runs
+ * times (default 20), so only thresher's parsing is timed. Finally, run
+ * the compiler runs times as thresher does, answering its prompts, so the
+ * pipes and replies are timed too. Print the lines and MB parsed per
+ * second for each.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <sys/time.h>
+
+#include "thresherSupport.h"
+
+/**\details
+ * Gives the time in seconds
+ *
+ * \return the current time in seconds
+ */
+static double now(void) {
+
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**\details
+ * Prints parseBench's usage and exits with ERR_USAGE
+ */
+static void usage(void) {
+
+    fprintf(stderr, "Usage: parseBench [type] [lines] [runs] [compiler]\n");
+    exit(ERR_USAGE);
+}
+
+/**\details
+ * Names the sample file for a build type, with the extension fakeCompiler
+ * uses to pick the style of output to print
+ *
+ * \param bt (the build type)
+ *
+ * \return the name of the file
+ */
+static char *sample_file(BuildType *bt) {
+
+    static const char *names[][2] = {
+            {"ansiC", "bench.c"}, {"c99", "bench.c"},
+            {"java", "bench.java"}, {"latex", "bench.tex"}
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (!strcmp(bt->name, names[i][0])) {
+            return (char *) names[i][1];
+        }
+    }
+
+    // Types from a rule file get gcc's output
+    return "bench";
+}
+
+/**\details
+ * Runs the compiler on ts->curFile as thresh_file does and parses its
+ * output, without printing a table
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param save (file to write the compiler's output to as it is read, or
+ * NULL)
+ */
+static void run_once(ThresherStruct *ts, FILE *save) {
+
+    ChildIO io;
+    int table[7], status;
+    char *buffer;
+    size_t len;
+
+    if (pipe(ts->childError) || pipe(ts->childInput)
+            || pipe(ts->childOutput) || pipe(ts->childOther)) {
+        quit(ERR_SYS, 0);
+    }
+    spawn_child(ts);
+    child_io_init(ts, &io);
+
+    if (save) {
+        // Answer the prompts the same way, but keep every line
+        while (child_io_next(&io, &buffer, &len) == 1) {
+            fwrite(buffer, 1, len, save);
+            fputc('\n', save);
+            rules_parse(ts->build, &buffer, len, ts->curFile, &io.replies);
+        }
+    } else {
+        parse_child(ts, table, &io);
+    }
+    child_io_finish(&io);
+    parse_child_error(&io);
+    waitpid(ts->pid, &status, 0);
+    childPid = 0;
+
+    child_io_free(&io);
+}
+
+/**\details
+ * Prints how quickly lines were parsed
+ *
+ * \param name (what was timed)
+ * \param lines (the number of lines parsed)
+ * \param bytes (the number of bytes parsed)
+ * \param seconds (the time it took)
+ */
+static void print_rate(const char *name, double lines, double bytes,
+        double seconds) {
+
+    printf("%-16s %12.0f lines/s %9.1f MB/s\n", name, lines / seconds,
+            bytes / seconds / (1024 * 1024));
+}
+
+int main(int argc, char **argv) {
+
+    char *type = argc > 1 ? argv[1] : "ansiC";
+    char *lines = argc > 2 ? argv[2] : "100000";
+    int runs = 20, numLines = 0, table[7], count;
+    ThresherStruct ts;
+    ChildIO io;
+    FILE *saved;
+    double start, elapsed, bytes;
+
+    memset(&ts, 0, sizeof(ts));
+    ts.diagFd = -1;
+    ts.cmd = argc > 4 ? argv[4] : "./fakeCompiler";
+    if ((argc > 2 && !get_num_arg(lines, &count))
+            || (argc > 3 && !get_num_arg(argv[3], &runs))) {
+        usage();
+    }
+
+    rules_load_builtin();
+    rules_compile();
+    if ((ts.type = rules_find(type)) == -1) {
+        quit(ERR_UNKNOWN, 0);
+    }
+    ts.build = &buildTypes[ts.type];
+    ts.curFile = sample_file(ts.build);
+    setenv("FAKECC_LINES", lines, 1);
+
+    // Save the output once, so it can be parsed without the compiler
+    if (!(saved = tmpfile())) {
+        quit(ERR_SYS, 0);
+    }
+    run_once(&ts, saved);
+    fflush(saved);
+    bytes = ftell(saved);
+
+    // Parse the saved output as if it came from a child with no other
+    // pipes, so replies are dropped
+    memset(&io, 0, sizeof(io));
+    io.err = io.other = io.in = -1;
+    start = now();
+    for (int i = 0; i < runs; ++i) {
+        lseek(fileno(saved), 0, SEEK_SET);
+        reader_init(&io.out, fileno(saved));
+        parse_child(&ts, table, &io);
+        reader_free(&io.out);
+    }
+    elapsed = now() - start;
+
+    // Count the lines parsed from the table of the last run
+    for (int i = 0; i < 6; ++i) {
+        numLines += table[i];
+    }
+    printf("%s, %d lines (%.1f MB) of %s output, %d runs\n", type,
+            numLines, bytes / (1024 * 1024), ts.cmd, runs);
+    print_rate("parse_child", (double) numLines * runs, bytes * runs,
+            elapsed);
+
+    start = now();
+    for (int i = 0; i < runs; ++i) {
+        run_once(&ts, NULL);
+    }
+    print_rate("with compiler", (double) numLines * runs, bytes * runs,
+            now() - start);
+
+    fclose(saved);
+    return 0;
+}
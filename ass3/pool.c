@@ -0,0 +1,330 @@
+/** 
+ * \file   pool.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the job pool used to run thresher on many files at once
+ * 
+ * \details
+ *
+ * Contains the functions that start the worker processes, read their 
+ * output as it arrives and print it in the order the files were given.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include "cache.h"
+#include "history.h"
+
+/** The jobs of the running pool, used by the signal handler */
+static JobStruct *poolJobs;
+
+/** The number of jobs in poolJobs */
+static int poolNumJobs;
+
+/**\details
+ * Checks whether a finished worker's compiler was stopped
+ *
+ * \param job (the reaped job)
+ *
+ * \return 1 if the worker quit with ERR_STOPPED
+ * \return 0 otherwise
+ */
+static int job_stopped(JobStruct *job) {
+
+    return WIFEXITED(job->status) && WEXITSTATUS(job->status) == ERR_STOPPED;
+}
+
+void pool_run(ThresherStruct *ts, char **files, int numFiles) {
+
+    JobStruct *jobs = (JobStruct *) calloc(numFiles, sizeof(JobStruct));
+    int maxJobs = ts->jobs > 1 ? ts->jobs : 1;
+    struct pollfd *fds = (struct pollfd *) malloc(sizeof(struct pollfd) 
+            * 3 * maxJobs);
+    JobStruct **owner = (JobStruct **) malloc(sizeof(JobStruct *) 
+            * 3 * maxJobs);
+    JobStruct **active = (JobStruct **) malloc(sizeof(JobStruct *) 
+            * maxJobs);
+    int *order = (int *) malloc(sizeof(int) * numFiles);
+    int next = 0, printed = 0, running = 0, failed = 0, numFds, status;
+    struct sigaction sa;
+    History history;
+
+    for (int i = 0; i < numFiles; ++i) {
+        jobs[i].file = files[i];
+        jobs[i].out = -1;
+        jobs[i].err = -1;
+        jobs[i].diag = -1;
+        order[i] = i;
+    }
+
+    // Start the files expected to take longest first, so that none is
+    // left running on its own at the end
+    if (ts->history) {
+        history_load(&history, ts->history);
+        if (maxJobs > 1) {
+            history_order(&history, files, numFiles, order);
+        }
+    }
+
+    // Kill the workers rather than a single child on SIGINT
+    pool_track(jobs, numFiles);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = pool_sigint_recieved;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &sa, 0);
+
+    while (printed < numFiles) {
+
+        // Keep up to ts->jobs workers running. Files whose result is in
+        // the cache are done without starting a worker.
+        while (running < maxJobs && next < numFiles) {
+            JobStruct *job = &jobs[order[next++]];
+
+            if (ts->cacheDir) {
+                cache_key(ts, job);
+                if (cache_lookup(ts, job)) {
+                    continue;
+                }
+            }
+            start_job(ts, jobs, numFiles, job);
+            active[running++] = job;
+        }
+
+        // Wait for any of the running workers to send something
+        numFds = 0;
+        for (int i = 0; i < running; ++i) {
+            if (active[i]->out != -1) {
+                owner[numFds] = active[i];
+                fds[numFds].fd = active[i]->out;
+                fds[numFds++].events = POLLIN;
+            }
+            if (active[i]->err != -1) {
+                owner[numFds] = active[i];
+                fds[numFds].fd = active[i]->err;
+                fds[numFds++].events = POLLIN;
+            }
+            if (active[i]->diag != -1) {
+                owner[numFds] = active[i];
+                fds[numFds].fd = active[i]->diag;
+                fds[numFds++].events = POLLIN;
+            }
+        }
+
+        if (numFds && poll(fds, numFds, -1) == -1 && errno != EINTR) {
+            quit(ERR_SYS, 0);
+        }
+
+        for (int i = 0; i < numFds; ++i) {
+            if (fds[i].revents && read_job(owner[i], fds[i].fd)) {
+                if (ts->cacheDir) {
+                    cache_store(ts, owner[i]);
+                }
+                // A stopped run's time is not how long the file takes
+                if (ts->history && !job_stopped(owner[i])) {
+                    history_set(&history, owner[i]->file, 
+                            report_now() - owner[i]->started);
+                }
+
+                // Take the job out of the running ones
+                for (int j = 0; j < running; ++j) {
+                    if (active[j] == owner[i]) {
+                        active[j] = active[--running];
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Print the finished jobs, in order, stopping at the first one that
+        // is still running.
+        while (printed < numFiles && jobs[printed].done) {
+            JobStruct *job = &jobs[printed++];
+
+            fwrite(job->outBuf.data, 1, job->outBuf.len, stdout);
+            fflush(stdout);
+            fwrite(job->errBuf.data, 1, job->errBuf.len, stderr);
+            free(job->outBuf.data);
+            free(job->errBuf.data);
+
+            if (ts->top) {
+                diag_read(&ts->diags, job->diagBuf.data, job->diagBuf.len);
+                free(job->diagBuf.data);
+            }
+
+            // If the worker quit, stop the others and quit the same way.
+            // A worker that died some other way is a system error. When
+            // counting diagnostics, carry on and quit at the end instead.
+            status = WIFEXITED(job->status) ? WEXITSTATUS(job->status) 
+                    : ERR_SYS;
+            status = status == ERR_STOPPED ? ERR_NONZERO : status;
+            if (status && ts->top) {
+                failed = failed ? failed : status;
+            } else if (status) {
+                stop_jobs();
+                if (ts->cacheDir) {
+                    cache_trim(ts);
+                }
+                if (ts->history) {
+                    history_save(&history, ts->history);
+                }
+                exit(status);
+            }
+        }
+    }
+
+    if (ts->cacheDir) {
+        cache_trim(ts);
+    }
+
+    if (ts->history) {
+        history_save(&history, ts->history);
+        history_free(&history);
+    }
+
+    if (ts->top) {
+        diag_print_top(&ts->diags, ts->top);
+        if (failed) {
+            exit(failed);
+        }
+    }
+
+    free(order);
+    free(active);
+    free(owner);
+    free(fds);
+    free(jobs);
+}
+
+void start_job(ThresherStruct *ts, JobStruct *jobs, int numJobs, 
+        JobStruct *job) {
+
+    int out[2], err[2], diag[2] = {-1, -1};
+    struct sigaction sa;
+
+    if (pipe(out) || pipe(err) || (ts->top && pipe(diag))) {
+        quit(ERR_SYS, 0);
+    }
+
+    // Don't let the worker inherit anything still waiting to be printed
+    fflush(stdout);
+    fflush(stderr);
+
+    switch (job->pid = fork()) {
+        case -1:
+            quit(ERR_SYS, 0);
+            break;
+        case 0:
+            // Only the worker's own pipes should stay open
+            for (int i = 0; i < numJobs; ++i) {
+                if (jobs[i].out != -1) {
+                    close(jobs[i].out);
+                }
+                if (jobs[i].err != -1) {
+                    close(jobs[i].err);
+                }
+                if (jobs[i].diag != -1) {
+                    close(jobs[i].diag);
+                }
+            }
+
+            if (dup2(out[WRITE], STDOUT_FILENO) == -1 
+                    || dup2(err[WRITE], STDERR_FILENO) == -1
+                    || close(out[READ]) || close(out[WRITE]) 
+                    || close(err[READ]) || close(err[WRITE])) {
+                exit(ERR_SYS);
+            }
+
+            // Count only this file's diagnostics, and send them back
+            if (ts->top) {
+                diag_free(&ts->diags);
+                close(diag[READ]);
+                ts->diagFd = diag[WRITE];
+            }
+
+            // Take the compiler down with the worker if it is killed
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = sigint_recieved;
+            sa.sa_flags = SA_RESTART;
+            sigaction(SIGINT, &sa, 0);
+            sigaction(SIGTERM, &sa, 0);
+
+            ts->curFile = job->file;
+            ts->worker = 1;
+            thresh_file(ts);
+
+            exit(0);
+    }
+
+    close(out[WRITE]);
+    close(err[WRITE]);
+    job->out = out[READ];
+    job->err = err[READ];
+    if (ts->top) {
+        close(diag[WRITE]);
+    }
+    job->diag = diag[READ];
+    job->started = report_now();
+}
+
+int read_job(JobStruct *job, int fd) {
+
+    char buffer[4096];
+    ssize_t count = read(fd, buffer, sizeof(buffer));
+
+    if (count > 0) {
+        buffer_append(fd == job->out ? &job->outBuf : fd == job->err 
+                ? &job->errBuf : &job->diagBuf, buffer, count);
+        return 0;
+    } else if (count == -1 && errno == EINTR) {
+        return 0;
+    }
+
+    // The pipe has been closed
+    close(fd);
+    if (fd == job->out) {
+        job->out = -1;
+    } else if (fd == job->err) {
+        job->err = -1;
+    } else {
+        job->diag = -1;
+    }
+
+    if (job->out != -1 || job->err != -1 || job->diag != -1) {
+        return 0;
+    }
+
+    // Every pipe has closed so the worker is done, reap it.
+    waitpid(job->pid, &job->status, 0);
+    job->pid = 0;
+    job->done = 1;
+
+    return 1;
+}
+
+void pool_track(JobStruct *jobs, int numJobs) {
+
+    poolJobs = jobs;
+    poolNumJobs = numJobs;
+}
+
+void stop_jobs(void) {
+
+    // Kill every worker that is still running, then reap them
+    for (int i = 0; i < poolNumJobs; ++i) {
+        if (poolJobs[i].pid) {
+            kill(poolJobs[i].pid, SIGTERM);
+        }
+    }
+    for (int i = 0; i < poolNumJobs; ++i) {
+        if (poolJobs[i].pid) {
+            waitpid(poolJobs[i].pid, NULL, 0);
+            poolJobs[i].pid = 0;
+        }
+    }
+}
+
+void pool_sigint_recieved(int s) {
+
+    stop_jobs();
+    quit(0, 0);
+}
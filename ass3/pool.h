@@ -0,0 +1,125 @@
+/** 
+ * \file   pool.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for pool.c
+ *
+ * \details
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "thresherSupport.h"
+
+#define CACHE_KEY_LEN 32
+
+/** \struct JobStruct
+ *  \brief Creates a structure that holds a file being summarised by a 
+ *          worker and the output the worker has sent back so far
+ */
+typedef struct {
+    char *file;             /**< The file the job summarises */
+    pid_t pid;              /**< Pid of the worker, 0 if not running */
+    int out;                /**< Read end of the worker's stdout, or -1 */
+    int err;                /**< Read end of the worker's stderr, or -1 */
+    int diag;               /**< Read end of the worker's diagnostics, or -1 */
+    Buffer outBuf;          /**< Everything the worker wrote to stdout */
+    Buffer errBuf;          /**< Everything the worker wrote to stderr */
+    Buffer diagBuf;         /**< The diagnostics the worker counted */
+    int status;             /**< The worker's exit status */
+    int done;               /**< Boolean for the worker having been reaped */
+    double started;         /**< When the worker was started, in ms */
+    char key[CACHE_KEY_LEN + 1];    /**< The job's cache key, or empty */
+} JobStruct;
+
+/**\details
+ * Summarises the files with up to ts->jobs files running at once. 
+ * 
+ * Each file is given to a worker process that runs thresh_file with its
+ * stdout and stderr sent down pipes. The pipes of every running worker 
+ * are read with poll() and buffered. Once a file and all of the files 
+ * before it have finished, its output is printed, so the output is in the
+ * same order as the files were given. If a worker quit with a non-zero 
+ * status, the remaining workers are killed and thresher quits with that 
+ * status once the file's output has been printed.
+ *
+ * If ts->top is set, each worker also sends back the diagnostics it 
+ * counted, which are added to ts->diags as the file is printed. Every file
+ * is run even if some quit with a non-zero status, then the most common 
+ * diagnostics are printed and thresher quits with the first non-zero 
+ * status.
+ *
+ * If ts->history is set, the files are started longest expected first
+ * (history_order), still printed in the order given, and how long each
+ * worker took is saved in the history for next time. A worker whose
+ * compiler was stopped (it quit with ERR_STOPPED) is not saved.
+ *
+ * If ts->cacheDir is set, a file whose result is in the cache is replayed
+ * from it rather than given to a worker, finished files are saved in it
+ * and the cache is trimmed to ts->cacheSize before returning.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param files (string array of the files to summarise)
+ * \param numFiles (the number of files)
+ */
+void pool_run(ThresherStruct *ts, char **files, int numFiles);
+
+/**\details
+ * Starts the worker for a job. 
+ * 
+ * Create the pipes for the worker and fork. The worker closes the pipes 
+ * of the other jobs, replaces stdout and stderr with its pipes and runs
+ * thresh_file on the job's file. If ts->top is set, a third pipe carries
+ * the worker's diagnostics (ts->diagFd).
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param jobs (array of all of the jobs)
+ * \param numJobs (the number of jobs)
+ * \param job (the job to start, value is modified by the function)
+ */
+void start_job(ThresherStruct *ts, JobStruct *jobs, int numJobs,
+        JobStruct *job);
+
+/**\details
+ * Reads what is waiting on one of a job's pipes. 
+ * 
+ * Append the data read to the matching buffer. If the pipe has been 
+ * closed, close our end, and once every pipe is closed reap the worker.
+ *
+ * \param job (the job to read from, value is modified by the function)
+ * \param fd (the pipe to read, job->out, job->err or job->diag)
+ * 
+ * \return 1 if the job has finished
+ * \return 0 otherwise
+ */
+int read_job(JobStruct *job, int fd);
+
+/**\details
+ * Sets the jobs whose workers stop_jobs kills.
+ *
+ * \param jobs (array of all of the jobs)
+ * \param numJobs (the number of jobs)
+ */
+void pool_track(JobStruct *jobs, int numJobs);
+
+/**\details
+ * Stops the pool's workers.
+ * 
+ * Kill the running workers using SIGTERM (each worker then kills its own
+ * child) and reap them.
+ */
+void stop_jobs(void);
+
+/**\details
+ * Handles SIGINT while the pool is running.
+ * 
+ * Stop the workers (stop_jobs) and then exit with status 0
+ *
+ * \param s (The signal number that cauased the function to be called)
+ */
+void pool_sigint_recieved(int s);
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * \file   report.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the machine readable output of thresher
+ *
+ * \details
+ *
+ * Contains the functions that print each file's counts, exit status and
+ * resource usage as JSON lines or CSV, in place of the tables.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <time.h>
+
+#include "report.h"
+
+/**\details
+ * Prints a string as a JSON string, with quotes and escapes
+ *
+ * \param str (the string to print)
+ */
+static void print_json_string(const char *str) {
+
+    putchar('"');
+    for (; *str; ++str) {
+        unsigned char c = (unsigned char) *str;
+
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+/**\details
+ * Prints a string as a CSV field, quoting it if it has to be
+ *
+ * \param str (the string to print)
+ */
+static void print_csv_field(const char *str) {
+
+    if (!strpbrk(str, ",\"\r\n")) {
+        fputs(str, stdout);
+        return;
+    }
+
+    putchar('"');
+    for (; *str; ++str) {
+        if (*str == '"') {
+            putchar('"');
+        }
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+/**\details
+ * Converts a time from rusage to milliseconds
+ *
+ * \param tv (the time)
+ *
+ * \return the time in milliseconds
+ */
+static double tv_ms(struct timeval tv) {
+
+    return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+}
+
+double report_now(void) {
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+void report_header(BuildType *bt) {
+
+    if (outputFormat != FORMAT_CSV) {
+        return;
+    }
+
+    printf("file,status,signal,wall_ms,user_ms,sys_ms,max_rss_kb,stopped");
+    for (int i = 0; i < NUM_CATEGORIES; ++i) {
+        if (bt->labels[i]) {
+            putchar(',');
+            print_csv_field(bt->labels[i]);
+        }
+    }
+    putchar('\n');
+}
+
+void report_record(BuildType *bt, int *table, char *curFile,
+        struct rusage *usage, double wall, const char *stopped) {
+
+    int status = table[6];
+    int first = 1;
+
+    if (outputFormat == FORMAT_JSON) {
+        printf("{\"file\":");
+        print_json_string(curFile);
+        printf(",\"counts\":{");
+        for (int i = 0; i < NUM_CATEGORIES; ++i) {
+            if (bt->labels[i]) {
+                printf(first ? "" : ",");
+                print_json_string(bt->labels[i]);
+                printf(":%d", table[i]);
+                first = 0;
+            }
+        }
+        putchar('}');
+        if (usage) {
+            printf(",\"status\":%d,\"signal\":%d,\"wall_ms\":%.3f,"
+                    "\"user_ms\":%.3f,\"sys_ms\":%.3f,\"max_rss_kb\":%ld",
+                    WIFEXITED(status) ? WEXITSTATUS(status) : -1,
+                    WIFSIGNALED(status) ? WTERMSIG(status) : 0, wall,
+                    tv_ms(usage->ru_utime), tv_ms(usage->ru_stime),
+                    usage->ru_maxrss);
+        }
+        if (stopped) {
+            printf(",\"stopped\":");
+            print_json_string(stopped);
+        }
+        printf("}\n");
+    } else {
+        print_csv_field(curFile);
+        if (usage) {
+            printf(",%d,%d,%.3f,%.3f,%.3f,%ld",
+                    WIFEXITED(status) ? WEXITSTATUS(status) : -1,
+                    WIFSIGNALED(status) ? WTERMSIG(status) : 0, wall,
+                    tv_ms(usage->ru_utime), tv_ms(usage->ru_stime),
+                    usage->ru_maxrss);
+        } else {
+            printf(",,,,,,");
+        }
+        putchar(',');
+        if (stopped) {
+            print_csv_field(stopped);
+        }
+        for (int i = 0; i < NUM_CATEGORIES; ++i) {
+            if (bt->labels[i]) {
+                printf(",%d", table[i]);
+            }
+        }
+        putchar('\n');
+    }
+}
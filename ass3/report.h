@@ -0,0 +1,66 @@
+/**
+ * \file   report.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for report.c
+ *
+ * \details
+ *
+ * With --format json, each file is printed as one JSON object on its own
+ * line:
+ *
+ *     {"file":"a.c","counts":{"implicit declaration":1,"undeclared":1},
+ *      "status":1,"signal":0,"wall_ms":41.2,"user_ms":30.1,"sys_ms":9.8,
+ *      "max_rss_kb":21444}
+ *
+ * With --format csv, a header line is printed first and then one line per
+ * file, with the same fields in the same order (a column per label). When
+ * logs are summarised there is no compiler, so the status and timing
+ * fields are left out of JSON records and empty in CSV records.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <sys/resource.h>
+
+#include "rules.h"
+
+/**\details
+ * Gives the time from a monotonic clock
+ *
+ * \return the time in milliseconds
+ */
+double report_now(void);
+
+/**\details
+ * Prints the header line of CSV output. Does nothing for other formats.
+ *
+ * \param bt (the build type, its labels name the count columns)
+ */
+void report_header(BuildType *bt);
+
+/**\details
+ * Prints the record of a file in outputFormat
+ *
+ * Give a count for every category with a label (including counts of 0),
+ * then the exit status, the signal that killed the compiler (0 if it
+ * exited), the wall time and, from usage, the user and system CPU time and
+ * the maximum resident set size. If the compiler was stopped, say why as
+ * "stopped" (left out of JSON, and empty in CSV, if it was not).
+ *
+ * \param bt (the build type)
+ * \param table (int table of size 7, table[6] is the wait status)
+ * \param curFile (string for the file)
+ * \param usage (the compiler's resource usage from wait4, NULL if there
+ * was no compiler)
+ * \param wall (milliseconds from starting the compiler to reaping it)
+ * \param stopped (why the compiler was stopped: "max-errors", "timeout",
+ * "server-died" or "cpu-limit", or NULL if it ran to the end)
+ */
+void report_record(BuildType *bt, int *table, char *curFile,
+        struct rusage *usage, double wall, const char *stopped);
+
+#endif
@@ -0,0 +1,564 @@
+/**
+ * \file   rules.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the loading and matching of thresher's build types
+ *
+ * \details
+ *
+ * Every build type, built in or read from a rule file, is loaded into the
+ * same structure and has its patterns compiled into one classifier at
+ * startup. Parsing a line and building a table is then the same for every
+ * type.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <strings.h>
+
+#include "rules.h"
+#include "ansiC.h"
+#include "java.h"
+#include "latex.h"
+
+BuildType *buildTypes = NULL;
+int numBuildTypes = 0;
+
+/**\details
+ * Reads a category from a rule file value
+ *
+ * \param value (string starting with the category)
+ * \param rest (set to the text after the category and its spaces, may be
+ * NULL)
+ *
+ * \return the category, quitting with ERR_RULES if it is not 0 to 5
+ */
+static int get_category(char *value, char **rest) {
+
+    if (value[0] < '0' || value[0] >= '0' + NUM_CATEGORIES
+            || (value[1] != ' ' && value[1] != '\0')) {
+        quit(ERR_RULES, 0);
+    }
+
+    if (rest) {
+        *rest = value + 1;
+        while (**rest == ' ') {
+            (*rest)++;
+        }
+    }
+
+    return value[0] - '0';
+}
+
+/**\details
+ * Copies a reply, turning "\n" into a newline and "\\" into a backslash
+ *
+ * \param value (the reply as written in the rule file)
+ *
+ * \return the reply to send, free with free()
+ */
+static char *get_reply(char *value) {
+
+    char *reply = (char *) malloc(strlen(value) + 1);
+    char *out = reply;
+
+    for (; *value; ++value) {
+        if (value[0] == '\\' && value[1] == 'n') {
+            *out++ = '\n';
+            value++;
+        } else if (value[0] == '\\' && value[1] == '\\') {
+            *out++ = '\\';
+            value++;
+        } else {
+            *out++ = *value;
+        }
+    }
+    *out = '\0';
+
+    return reply;
+}
+
+/**\details
+ * Splits a command template into its arguments
+ *
+ * \param value (the arguments separated by spaces)
+ *
+ * \return the NULL terminated list of arguments
+ */
+static char **get_command(char *value) {
+
+    char **command = (char **) malloc(sizeof(char *));
+    char *save, *arg;
+    int count = 0;
+
+    for (arg = strtok_r(value, " \t", &save); arg;
+            arg = strtok_r(NULL, " \t", &save)) {
+        command = (char **) realloc(command, sizeof(char *) * (count + 2));
+        command[count++] = strdup(arg);
+    }
+    command[count] = NULL;
+
+    return command;
+}
+
+/**\details
+ * Frees a command template made by get_command
+ *
+ * \param command (the NULL terminated list of arguments, may be NULL)
+ */
+static void free_command(char **command) {
+
+    if (!command) {
+        return;
+    }
+
+    for (char **arg = command; *arg; ++arg) {
+        free(*arg);
+    }
+    free(command);
+}
+
+/**\details
+ * Frees everything a build type holds, leaving the structure itself
+ *
+ * \param bt (the build type to free)
+ */
+static void free_type(BuildType *bt) {
+
+    free(bt->name);
+    free_command(bt->command);
+    free_command(bt->batch);
+    free_command(bt->json);
+    free_command(bt->syntax);
+    free_command(bt->nonstop);
+    free_command(bt->server);
+    free(bt->log);
+
+    for (int i = 0; i < bt->numRules; ++i) {
+        free(bt->rules[i].pattern);
+        free(bt->rules[i].reply);
+    }
+    for (int i = 0; i < NUM_CATEGORIES; ++i) {
+        free(bt->labels[i]);
+    }
+
+    classifier_free(&bt->classifier);
+}
+
+/**\details
+ * Starts a new build type, or clears the build type with the same name
+ *
+ * \param name (the name of the build type)
+ *
+ * \return the index of the build type in buildTypes
+ */
+static int new_type(char *name) {
+
+    int index = rules_find(name);
+    BuildType *bt;
+
+    if (index == -1) {
+        index = numBuildTypes++;
+        buildTypes = (BuildType *) realloc(buildTypes,
+                sizeof(BuildType) * numBuildTypes);
+    } else {
+        free_type(&buildTypes[index]);
+    }
+
+    bt = &buildTypes[index];
+    memset(bt, 0, sizeof(BuildType));
+    bt->name = strdup(name);
+    bt->output = STDERR_FILENO;
+    bt->prefix = 1;
+
+    return index;
+}
+
+void rules_load(const char *text) {
+
+    char *copy = strdup(text);
+    char *line, *next, *value, *end;
+    BuildType *bt;
+    int index = -1;
+
+    for (line = copy; line; line = next) {
+
+        // Split off the next line, dropping any '\r' and leading spaces
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        end = line + strlen(line);
+        if (end > line && end[-1] == '\r') {
+            end[-1] = '\0';
+        }
+        while (*line == ' ' || *line == '\t') {
+            line++;
+        }
+
+        // Skip blank lines and comments
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+
+        // Split the keyword from its value
+        value = line + strcspn(line, " \t");
+        if (*value) {
+            *value++ = '\0';
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+        }
+
+        if (!strcmp(line, "type") && *value) {
+            index = new_type(value);
+            continue;
+        } else if (index == -1) {
+            quit(ERR_RULES, 0);
+        }
+
+        bt = &buildTypes[index];
+
+        if (!strcmp(line, "command") && *value) {
+            free_command(bt->command);
+            bt->command = get_command(value);
+        } else if (!strcmp(line, "batch") && *value) {
+            free_command(bt->batch);
+            bt->batch = get_command(value);
+        } else if (!strcmp(line, "json") && *value) {
+            free_command(bt->json);
+            bt->json = get_command(value);
+        } else if (!strcmp(line, "syntax") && *value) {
+            free_command(bt->syntax);
+            bt->syntax = get_command(value);
+        } else if (!strcmp(line, "nonstop") && *value) {
+            free_command(bt->nonstop);
+            bt->nonstop = get_command(value);
+        } else if (!strcmp(line, "log") && *value) {
+            free(bt->log);
+            bt->log = strdup(value);
+        } else if (!strcmp(line, "server") && *value) {
+            free_command(bt->server);
+            bt->server = get_command(value);
+        } else if (!strcmp(line, "output") && !strcmp(value, "stdout")) {
+            bt->output = STDOUT_FILENO;
+        } else if (!strcmp(line, "output") && !strcmp(value, "stderr")) {
+            bt->output = STDERR_FILENO;
+        } else if (!strcmp(line, "prefix") && !strcmp(value, "yes")) {
+            bt->prefix = 1;
+        } else if (!strcmp(line, "prefix") && !strcmp(value, "no")) {
+            bt->prefix = 0;
+        } else if (!strcmp(line, "rule") && bt->numRules == MAX_PATTERNS) {
+            // The classifier has one bit for each rule
+            quit(ERR_RULES, 0);
+        } else if (!strcmp(line, "rule")) {
+            Rule *rule = &bt->rules[bt->numRules++];
+            rule->category = get_category(value, &value);
+            if (*value == '\0') {
+                quit(ERR_RULES, 0);
+            }
+            rule->pattern = strdup(value);
+        } else if (!strcmp(line, "reply") && bt->numRules > 0) {
+            free(bt->rules[bt->numRules - 1].reply);
+            bt->rules[bt->numRules - 1].reply = get_reply(value);
+        } else if (!strcmp(line, "default")) {
+            bt->fallback = get_category(value, NULL);
+        } else if (!strcmp(line, "label")) {
+            int category = get_category(value, &value);
+            free(bt->labels[category]);
+            bt->labels[category] = strdup(value);
+        } else {
+            quit(ERR_RULES, 0);
+        }
+    }
+
+    free(copy);
+}
+
+void rules_load_file(char *path) {
+
+    FILE *file = fopen(path, "r");
+    Buffer text = {NULL, 0, 0};
+    char chunk[4096];
+    size_t count;
+
+    if (!file) {
+        quit(ERR_RULES, 0);
+    }
+
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        buffer_append(&text, chunk, count);
+    }
+    buffer_append(&text, "", 1);
+    fclose(file);
+
+    rules_load(text.data);
+    free(text.data);
+}
+
+void rules_load_builtin(void) {
+
+    static int loaded = 0;
+
+    // A daemon's requests start with the types it loaded already
+    if (loaded) {
+        return;
+    }
+    loaded = 1;
+
+    // Loaded in the order of ANSIC, CNN, JAVA and LATEX
+    rules_load(ansiCRules);
+    rules_load(c99Rules);
+    rules_load(javaRules);
+    rules_load(latexRules);
+
+    buildTypes[JAVA].serverSource = javaServerSource;
+}
+
+void rules_compile(void) {
+
+    for (int i = 0; i < numBuildTypes; ++i) {
+        BuildType *bt = &buildTypes[i];
+
+        // Types compiled before (by a daemon) are left as they are
+        if (bt->classifier.compiled) {
+            continue;
+        }
+
+        // A type that can't be run is no use, and a nonstop run is no use
+        // without its log
+        if (!bt->command || !bt->command[0] || (bt->nonstop && !bt->log)) {
+            quit(ERR_RULES, 0);
+        }
+
+        // Only a built in type has a server source to run
+        if (bt->server && rules_server_source(bt) && !bt->serverSource) {
+            quit(ERR_RULES, 0);
+        }
+
+        // The rules are added in order, so the lowest bit found is the rule
+        // with the highest precedence
+        classifier_init(&bt->classifier);
+        for (int j = 0; j < bt->numRules; ++j) {
+            if (!classifier_add(&bt->classifier, bt->rules[j].pattern)) {
+                quit(ERR_RULES, 0);
+            }
+        }
+        classifier_compile(&bt->classifier);
+    }
+}
+
+int rules_find(char *name) {
+
+    for (int i = 0; i < numBuildTypes; ++i) {
+        if (!strcmp(buildTypes[i].name, name)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**\details
+ * Fills in a command template
+ *
+ * \param command (the template, NULL terminated)
+ * \param cmd (string %c is replaced with)
+ * \param files (string array %f is replaced with)
+ * \param numFiles (the number of files)
+ *
+ * \return the NULL terminated argument list, free with free()
+ */
+static char **fill_command(char **command, char *cmd, char **files,
+        int numFiles) {
+
+    int count = 0, used = 0;
+    char **args;
+
+    while (command[count]) {
+        count++;
+    }
+
+    // A server's template is given no files
+    args = (char **) malloc(sizeof(char *) 
+            * (count * (numFiles ? numFiles : 1) + 1));
+
+    for (int i = 0; i < count; ++i) {
+        if (!strcmp(command[i], "%c")) {
+            args[used++] = cmd;
+        } else if (!strcmp(command[i], "%f")) {
+            for (int j = 0; j < numFiles; ++j) {
+                args[used++] = files[j];
+            }
+        } else {
+            args[used++] = command[i];
+        }
+    }
+    args[used] = NULL;
+
+    return args;
+}
+
+char **rules_args(BuildType *bt, char *cmd, char *file) {
+
+    return fill_command(bt->command, cmd, &file, 1);
+}
+
+char **rules_batch_args(BuildType *bt, char *cmd, char **files, 
+        int numFiles) {
+
+    return fill_command(bt->batch, cmd, files, numFiles);
+}
+
+char **rules_json_args(BuildType *bt, char *cmd, char *file) {
+
+    return fill_command(bt->json, cmd, &file, 1);
+}
+
+char **rules_syntax_args(BuildType *bt, char **args) {
+
+    int count = 0, extra = 0;
+    char **added;
+
+    while (args[count]) {
+        count++;
+    }
+    while (bt->syntax[extra]) {
+        extra++;
+    }
+
+    added = (char **) malloc(sizeof(char *) * (count + extra + 1));
+    added[0] = args[0];
+    memcpy(added + 1, bt->syntax, sizeof(char *) * extra);
+    memcpy(added + 1 + extra, args + 1, sizeof(char *) * count);
+    free(args);
+
+    return added;
+}
+
+char **rules_nonstop_args(BuildType *bt, char *cmd, char *file) {
+
+    return fill_command(bt->nonstop, cmd, &file, 1);
+}
+
+char **rules_server_args(BuildType *bt, char *cmd, char *source) {
+
+    char **args = fill_command(bt->server, cmd, NULL, 0);
+
+    for (int i = 0; args[i]; ++i) {
+        if (!strcmp(args[i], "%s")) {
+            args[i] = source;
+        }
+    }
+
+    return args;
+}
+
+int rules_server_source(BuildType *bt) {
+
+    for (int i = 0; bt->server[i]; ++i) {
+        if (!strcmp(bt->server[i], "%s")) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+char *rules_log_path(BuildType *bt, char *file) {
+
+    char *base = strrchr(file, '/'), *path, *dot;
+
+    // The compiler writes the log where it is run, not beside the file
+    base = base ? base + 1 : file;
+    path = (char *) malloc(strlen(base) + strlen(bt->log) + 1);
+    strcpy(path, base);
+    if ((dot = strrchr(path, '.')) && dot != path) {
+        *dot = '\0';
+    }
+    strcat(path, bt->log);
+
+    return path;
+}
+
+int rules_match(BuildType *bt, const char *buffer, size_t len) {
+
+    // Find every pattern in the buffer at once
+    unsigned int found = classifier_match(&bt->classifier, buffer, len);
+
+    // The first rule that matched wins
+    return found ? ffs((int) found) - 1 : -1;
+}
+
+/**\details
+ * Gives the category of a matched rule, queueing its reply if it has one
+ *
+ * \param bt (the build type)
+ * \param rule (the index of the rule, -1 if none matched)
+ * \param replies (the replies waiting to be written to the child, value is
+ * modified)
+ *
+ * \return the rule's category, or the fallback category if none matched
+ */
+static int rule_category(BuildType *bt, int rule, Buffer *replies) {
+
+    if (rule == -1) {
+        return bt->fallback;
+    }
+
+    // Queue the rule's reply if it has one, it is written once the child
+    // can take it
+    if (bt->rules[rule].reply) {
+        buffer_append(replies, bt->rules[rule].reply, 
+                strlen(bt->rules[rule].reply));
+    }
+
+    return bt->rules[rule].category;
+}
+
+int rules_parse(BuildType *bt, char **buffer, size_t len, char *curFile,
+        Buffer *replies) {
+
+    // If the buffer does not begin with "name:number":, return 0
+    if (bt->prefix && !is_name_no(buffer, curFile)) {
+        return 0;
+    }
+
+    return rule_category(bt, rules_match(bt, *buffer, len), replies);
+}
+
+int rules_classify(BuildType *bt, const char *kind, const char *file,
+        const char *message, size_t len, char *curFile, Buffer *replies) {
+
+    // A note only adds to the diagnostic before it
+    if (!strcmp(kind, "note")) {
+        return 0;
+    }
+
+    // As with a line, a diagnostic must be about the file
+    if (bt->prefix && strcmp(file, curFile)) {
+        return 0;
+    }
+
+    return rule_category(bt, rules_match(bt, message, len), replies);
+}
+
+void rules_print_table(BuildType *bt, int *table) {
+
+    // If the table value is greater than 0 and the category has a label,
+    // print the number of times the error occurred and the label.
+    for (int i = 0; i < NUM_CATEGORIES; ++i) {
+        if (bt->labels[i] && table[i]) {
+            printf("%d %s\n", table[i], bt->labels[i]);
+        }
+    }
+}
+
+void rules_build_table(BuildType *bt, int *table, char *curFile) {
+
+    rules_print_table(bt, table);
+
+    // If the child exited normally, give the exit status. Otherwise inform
+    // the user.
+    child_exit_status(curFile, table[6]);
+}
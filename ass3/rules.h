@@ -0,0 +1,330 @@
+/**
+ * \file   rules.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for rules.c
+ *
+ * \details
+ *
+ * A build type is described by a rule file. Each line is a keyword and its
+ * value, blank lines and lines starting with '#' are ignored:
+ *
+ *     type name              starts a new build type called name
+ *     command arg ...        the compiler's arguments, %c is replaced with
+ *                            the command and %f with the file
+ *     batch arg ...          the arguments to compile many files in one
+ *                            run (--batch), %f is replaced with every file
+ *     json arg ...           the arguments to have gcc print its 
+ *                            diagnostics as JSON (--json-diagnostics)
+ *     syntax arg ...         arguments added after the command to only
+ *                            check the file's syntax (--syntax-only)
+ *     nonstop arg ...        the arguments to run without stopping for
+ *                            replies (--nonstop), the log it writes is
+ *                            counted instead of its output
+ *     log extension          the log's name is the file's, without its
+ *                            directory, with its extension replaced
+ *     server arg ...         the arguments to start a compile server that
+ *                            is sent every file (--server, see server.h),
+ *                            %s is replaced with the path of a built in
+ *                            type's server source (only java has one)
+ *     output stdout|stderr   the compiler stream that is parsed
+ *     prefix yes|no          whether lines not starting with "file:num:"
+ *                            are put in category 0
+ *     rule category pattern  lines containing pattern go in category, the
+ *                            first rule (in file order) that matches wins
+ *     reply text             sent to the compiler when the last rule
+ *                            matches, "\n" is a newline
+ *     default category       the category when no rule matches
+ *     label category text    the table line for the category, categories
+ *                            without a label are not printed
+ *
+ * Categories are 0 to 5, and a type can have up to MAX_PATTERNS rules.
+ *
+ * When a log is counted, a line whose rule replies with "X" is the last
+ * one counted, as the reply would have ended an interactive run there.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include "classifier.h"
+
+#define NUM_CATEGORIES 6
+
+/** \struct Rule
+ *  \brief A pattern, the category it gives and the reply it sends
+ */
+typedef struct {
+    char *pattern;          /**< The text a line must contain */
+    int category;           /**< The table entry the line is counted in */
+    char *reply;            /**< Sent to the compiler on a match, or NULL */
+} Rule;
+
+/** \struct BuildType
+ *  \brief Everything thresher needs to know to run and summarise one type
+ *          of compiler
+ */
+typedef struct {
+    char *name;             /**< The name given on the command line */
+    char **command;         /**< The argument template, NULL terminated */
+    char **batch;           /**< The template for many files, or NULL */
+    char **json;            /**< The template for JSON output, or NULL */
+    char **syntax;          /**< The arguments to only check syntax, or NULL */
+    char **nonstop;         /**< The template that never stops, or NULL */
+    char *log;              /**< The extension of its log, or NULL */
+    char **server;          /**< The template of a compile server, or NULL */
+    const char *serverSource;   /**< The source of its server, or NULL */
+    int output;             /**< STDOUT_FILENO or STDERR_FILENO */
+    int prefix;             /**< Boolean for lines needing "file:num:" */
+    Rule rules[MAX_PATTERNS];   /**< The rules in order of precedence */
+    int numRules;           /**< The number of rules */
+    int fallback;           /**< The category when no rule matches */
+    char *labels[NUM_CATEGORIES];   /**< Table lines, NULL if not printed */
+    Classifier classifier;  /**< The compiled patterns of the rules */
+} BuildType;
+
+//! Global var. The build types that have been loaded.
+extern BuildType *buildTypes;
+
+//! Global var. The number of build types that have been loaded.
+extern int numBuildTypes;
+
+/**\details
+ * Loads build types from the text of a rule file
+ *
+ * Read the text a line at a time, starting a new build type at each "type"
+ * line (replacing any type already loaded with the same name) and filling
+ * it in from the lines that follow. If a line cannot be understood, quit
+ * with ERR_RULES.
+ *
+ * \param text (the contents of the rule file)
+ */
+void rules_load(const char *text);
+
+/**\details
+ * Loads build types from a rule file
+ *
+ * Read the whole file and load it with rules_load. If the file cannot be
+ * read, quit with ERR_RULES.
+ *
+ * \param path (the path of the rule file)
+ */
+void rules_load_file(char *path);
+
+/**\details
+ * Loads the built in build types: ansiC, c99, java and latex, so that their
+ * indexes are ANSIC, CNN, JAVA and LATEX, along with java's server source.
+ * Does nothing if they were loaded before.
+ */
+void rules_load_builtin(void);
+
+/**\details
+ * Compiles the patterns of every loaded build type into its classifier,
+ * skipping the types that are already compiled
+ */
+void rules_compile(void);
+
+/**\details
+ * Finds a loaded build type by name
+ *
+ * \param name (the name of the build type)
+ *
+ * \return the index of the build type in buildTypes
+ * \return -1 if there is no such type
+ */
+int rules_find(char *name);
+
+/**\details
+ * Builds the argument list to exec the compiler with
+ *
+ * Copy the build type's command template, replacing %c with cmd and %f
+ * with file.
+ *
+ * \param bt (the build type)
+ * \param cmd (string for the command to compile with)
+ * \param file (string for the file to compile)
+ *
+ * \return the NULL terminated argument list, free with free()
+ */
+char **rules_args(BuildType *bt, char *cmd, char *file);
+
+/**\details
+ * Builds the argument list to exec the compiler with for many files
+ *
+ * Copy the build type's batch template, replacing %c with cmd and %f with
+ * every file.
+ *
+ * \param bt (the build type, which must have a batch template)
+ * \param cmd (string for the command to compile with)
+ * \param files (string array of the files to compile)
+ * \param numFiles (the number of files)
+ *
+ * \return the NULL terminated argument list, free with free()
+ */
+char **rules_batch_args(BuildType *bt, char *cmd, char **files, 
+        int numFiles);
+
+/**\details
+ * Builds the argument list to exec the compiler with so that it prints its
+ * diagnostics as JSON
+ *
+ * Copy the build type's json template, replacing %c with cmd and %f with
+ * file.
+ *
+ * \param bt (the build type, which must have a json template)
+ * \param cmd (string for the command to compile with)
+ * \param file (string for the file to compile)
+ *
+ * \return the NULL terminated argument list, free with free()
+ */
+char **rules_json_args(BuildType *bt, char *cmd, char *file);
+
+/**\details
+ * Adds the build type's syntax arguments to an argument list, straight 
+ * after the command, so that the compiler only checks the syntax
+ *
+ * \param bt (the build type, which must have syntax arguments)
+ * \param args (the argument list, which is freed)
+ *
+ * \return the NULL terminated argument list, free with free()
+ */
+char **rules_syntax_args(BuildType *bt, char **args);
+
+/**\details
+ * Builds the argument list to exec the compiler with so that it never
+ * waits for a reply
+ *
+ * Copy the build type's nonstop template, replacing %c with cmd and %f 
+ * with file.
+ *
+ * \param bt (the build type, which must have a nonstop template)
+ * \param cmd (string for the command to compile with)
+ * \param file (string for the file to compile)
+ *
+ * \return the NULL terminated argument list, free with free()
+ */
+char **rules_nonstop_args(BuildType *bt, char *cmd, char *file);
+
+/**\details
+ * Builds the argument list to exec the build type's compile server with
+ *
+ * Copy the build type's server template, replacing %c with cmd and %s
+ * with source. The files are sent to the server once it is running.
+ *
+ * \param bt (the build type, which must have a server template)
+ * \param cmd (string for the command to compile with)
+ * \param source (string for the path of the server's source, or NULL if
+ * the template has no %s)
+ *
+ * \return the NULL terminated argument list, free with free()
+ */
+char **rules_server_args(BuildType *bt, char *cmd, char *source);
+
+/**\details
+ * Checks whether the build type's server template needs its source written
+ * out (has %s)
+ *
+ * \param bt (the build type, which must have a server template)
+ *
+ * \return 1 if it has %s
+ * \return 0 otherwise
+ */
+int rules_server_source(BuildType *bt);
+
+/**\details
+ * Gives the path of the log the compiler writes for a file, in the working
+ * directory
+ *
+ * \param bt (the build type, which must have a log extension)
+ * \param file (string for the file compiled)
+ *
+ * \return the path, free with free()
+ */
+char *rules_log_path(BuildType *bt, char *file);
+
+/**\details
+ * Finds the first of the build type's rules whose pattern is in the buffer.
+ * The buffer does not need to be terminated.
+ *
+ * \param bt (the build type)
+ * \param buffer (the line to search)
+ * \param len (the length of the buffer)
+ *
+ * \return the index of the rule in bt->rules
+ * \return -1 if no rule matches
+ */
+int rules_match(BuildType *bt, const char *buffer, size_t len);
+
+/**\details
+ * Parses the buffer under the build type's rules, and returns the category
+ * the line belongs in.
+ *
+ * If the build type needs a prefix and the buffer does not begin with
+ * "name:number:", return 0. Otherwise find the first rule whose pattern
+ * is in the buffer, add its reply for the child to replies (if it has 
+ * one) and return its category. If no rule matches, return the fallback
+ * category.
+ *
+ * \param bt (the build type)
+ * \param buffer (string containing the last read line from the child)
+ * \param len (the length of the buffer)
+ * \param curFile (string for the current file)
+ * \param replies (the replies waiting to be written to the child, value is
+ * modified)
+ *
+ * \return the category of the buffer
+ */
+int rules_parse(BuildType *bt, char **buffer, size_t len, char *curFile,
+        Buffer *replies);
+
+/**\details
+ * Classifies a diagnostic the compiler gave in parts (such as gcc's JSON)
+ * under the build type's rules, and returns the category it belongs in.
+ *
+ * A note, or a diagnostic not about curFile when the build type needs a
+ * prefix, is category 0. Otherwise find the first rule whose pattern is
+ * in the message alone, add its reply to replies (if it has one) and
+ * return its category. If no rule matches, return the fallback category.
+ *
+ * \param bt (the build type)
+ * \param kind (string for the kind of diagnostic, such as "error")
+ * \param file (string for the file it is about, empty if none)
+ * \param message (the message)
+ * \param len (the length of the message)
+ * \param curFile (string for the current file)
+ * \param replies (the replies waiting to be written to the child, value is
+ * modified)
+ *
+ * \return the category of the diagnostic
+ */
+int rules_classify(BuildType *bt, const char *kind, const char *file,
+        const char *message, size_t len, char *curFile, Buffer *replies);
+
+/**\details
+ * Prints the counts of the table.
+ *
+ * For each category with a label, if the table value is greater than 0,
+ * print the number of times and the label.
+ *
+ * \param bt (the build type)
+ * \param table (int table of at least NUM_CATEGORIES)
+ */
+void rules_print_table(BuildType *bt, int *table);
+
+/**\details
+ * Builds the table that shows what errors were encountered.
+ *
+ * Print the counts of the table (rules_print_table).
+ *
+ * If the child exited normally, give the exit status. Otherwise inform the
+ * user. If the child exited with a non-zero status, quit with status 5.
+ *
+ * \param bt (the build type)
+ * \param table (int table of size 7)
+ * \param curFile (string for the current file)
+ */
+void rules_build_table(BuildType *bt, int *table, char *curFile);
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * \file   server.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the compile server mode of thresher
+ *
+ * \details
+ *
+ * Contains the functions that keep one compiler process running for every
+ * file, so that a compiler with a slow start (like a JVM) only pays for it
+ * once, and split what it sends back into a table for each file.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include "server.h"
+
+/** The server source written for the run, removed when thresher exits */
+static char *sourcePath;
+
+/**\details
+ * Removes the server source written for the run, at exit
+ */
+static void server_remove_source(void) {
+
+    unlink(sourcePath);
+}
+
+/**\details
+ * Writes the build type's server source to a new file in $TMPDIR (or
+ * /tmp), removed when thresher exits
+ *
+ * \param ts (ThresherStruct with initialised values, serverSource is set)
+ */
+static void server_write_source(ThresherStruct *ts) {
+
+    const char *dir = getenv("TMPDIR");
+    FILE *file;
+    int fd;
+
+    if (!dir || !*dir) {
+        dir = "/tmp";
+    }
+
+    // java only runs a source file with the .java extension
+    sourcePath = (char *) malloc(strlen(dir) + 32);
+    sprintf(sourcePath, "%s/thresherServerXXXXXX.java", dir);
+    if ((fd = mkstemps(sourcePath, 5)) == -1) {
+        quit(ERR_SYS, 0);
+    }
+    atexit(server_remove_source);
+
+    if (!(file = fdopen(fd, "w")) || fputs(ts->build->serverSource, file)
+            == EOF || fclose(file)) {
+        quit(ERR_SYS, 0);
+    }
+    ts->serverSource = sourcePath;
+}
+
+/**\details
+ * Starts the compile server, and sets up the parent's ends of its pipes
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param io (the server's pipes, value is modified)
+ */
+static void server_start(ThresherStruct *ts, ChildIO *io) {
+
+    if (pipe(ts->childError) || pipe(ts->childInput) 
+            || pipe(ts->childOutput) || pipe(ts->childOther)) {
+        quit(ERR_SYS, 0);
+    }
+
+    token_acquire();
+    spawn_child(ts);
+    child_io_init(ts, io);
+}
+
+/**\details
+ * Stops the compile server, once its input has been closed or it has 
+ * ended, and reaps it
+ *
+ * \param ts (ThresherStruct with the server's pid)
+ * \param io (the server's pipes, which are freed)
+ *
+ * \return the server's exit status
+ */
+static int server_stop(ThresherStruct *ts, ChildIO *io) {
+
+    int status;
+
+    child_io_finish(io);
+    parse_child_error(io);
+
+    waitpid(ts->pid, &status, 0);
+    childPid = 0;
+    token_release();
+    child_io_free(io);
+
+    return status;
+}
+
+/**\details
+ * Sends one file to the compile server and parses what it sends back
+ *
+ * \param ts (ThresherStruct with curFile set)
+ * \param io (the server's pipes)
+ * \param table (int table of size 7, value is modified by the function)
+ *
+ * \return 1 if the server answered, with the status in table[6]
+ * \return 0 if the server ended first
+ */
+static int server_file(ThresherStruct *ts, ChildIO *io, int table[]) {
+
+    size_t doneLen = strlen(SERVER_DONE), len;
+    char *buffer, extra;
+    int status;
+
+    for (int i = 0; i < 7; ++i) {
+        table[i] = 0;
+    }
+
+    // The file's name is written as the server reads it
+    buffer_append(&io->replies, ts->curFile, strlen(ts->curFile));
+    buffer_append(&io->replies, "\n", 1);
+
+    while (child_io_next(io, &buffer, &len) == 1) {
+        // The status is a number and nothing else
+        if (!strncmp(buffer, SERVER_DONE, doneLen) && sscanf(buffer 
+                + doneLen, "%d%c", &status, &extra) == 1 && status >= 0) {
+            table[6] = W_EXITCODE(status, 0);
+            return 1;
+        }
+
+        if (ts->show) {
+            printf("%s\n", buffer);
+        }
+        table[rules_parse(ts->build, &buffer, len, ts->curFile, 
+                &io->replies)]++;
+    }
+
+    return 0;
+}
+
+void server_run(ThresherStruct *ts, char **files, int numFiles) {
+
+    struct sigaction sa;
+    ChildIO io;
+    int running = 0, table[7];
+
+    // Types without a server run one file at a time
+    if (!ts->build->server) {
+        for (int i = 0; i < numFiles; ++i) {
+            ts->curFile = files[i];
+            thresh_file(ts);
+        }
+        return;
+    }
+
+    if (rules_server_source(ts->build)) {
+        server_write_source(ts);
+    }
+
+    // A server that has ended must not take thresher with it when the next
+    // file is written
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, 0);
+
+    for (int i = 0; i < numFiles; ++i) {
+        ts->curFile = files[i];
+
+        if (!running) {
+            server_start(ts, &io);
+            running = 1;
+        }
+        ts->started = report_now();
+
+        if (outputFormat == FORMAT_TEXT) {
+            printf("----\n");
+        }
+
+        // A server that ended without answering is started again for the
+        // file, which fails if the new one ends too, whatever its status
+        ts->serverDied = 0;
+        if (!server_file(ts, &io, table)) {
+            server_stop(ts, &io);
+            server_start(ts, &io);
+            if (!server_file(ts, &io, table)) {
+                table[6] = server_stop(ts, &io);
+                ts->serverDied = 1;
+                running = 0;
+            }
+        }
+
+        if (ts->show) {
+            printf("----\n");
+        }
+
+        // The server's resource use is not split between the files
+        build_table(ts, table, NULL);
+
+        if (outputFormat == FORMAT_TEXT) {
+            printf("----\n");
+        }
+    }
+
+    // Closing its input stops the server
+    if (running) {
+        server_stop(ts, &io);
+    }
+}
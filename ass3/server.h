@@ -0,0 +1,57 @@
+/**
+ * \file   server.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for server.c
+ *
+ * \details
+ *
+ * A compile server is started once, from the build type's server template,
+ * and kept running for every file. It speaks a simple protocol over its
+ * pipes:
+ *
+ *     thresher writes     file\n
+ *     the server writes   the compiler's lines about file, on the build
+ *                         type's output stream, then
+ *                         thresher-done status\n
+ *
+ * where status is the exit status compiling file alone would have given.
+ * The server stops at the end of its input.
+ *
+ * javac does not speak this protocol by itself, so the java type's server
+ * is a small program around javax.tools.JavaCompiler that does
+ * (javaServerSource, see java.h). It is written to a temporary file and
+ * run with "java file -d .". Other servers are plugged in with a rule file
+ * given by --rules, as a type with a server template. The server's replies
+ * would be read as file names, so its rules should not have any.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "thresherSupport.h"
+
+//! The start of the line that ends the server's output for a file
+#define SERVER_DONE "thresher-done "
+
+/**\details
+ * Summarises the files with one long-running compile server.
+ *
+ * If the build type has no server template, each file is run on its own as
+ * usual. Otherwise write the type's server source if its template needs
+ * it, start the server with spawn_child, then send it each file in turn,
+ * parse the lines it sends back until SERVER_DONE and print the file's
+ * table as create_parent would, with the status the server
+ * gave. If the server ends before answering, the file is sent to a new 
+ * server, and if that one ends without answering too the file fails as
+ * not answered (with the server's exit status, and serverDied set).
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param files (string array of the files to summarise)
+ * \param numFiles (the number of files)
+ */
+void server_run(ThresherStruct *ts, char **files, int numFiles);
+
+#endif
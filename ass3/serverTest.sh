@@ -0,0 +1,139 @@
+#!/bin/sh
+#
+# serverTest.sh
+# Author: Merrick Heley (merrick.heley@uqconnect.edu.au)
+#
+# Tests thresher's --server mode against fakeCompiler's compile server.
+# Run from ass3 with thresher and fakeCompiler built (make test). Checks
+# that each file gets the table and status it gets when run on its own,
+# that a server that ends between files is started again, that a file
+# the server ends without answering fails, and that the java type runs its
+# server source with java. Prints each check and exits with 1 if any
+# failed.
+
+THRESHER=$PWD/thresher
+FAKECC=$PWD/fakeCompiler
+DIR=$(mktemp -d)
+FAILED=0
+
+trap 'rm -rf "$DIR"' EXIT
+
+# The latex type with a server, without the replies (which a server would
+# read as file names)
+cat > "$DIR/server.rules" <<EOF
+type texServer
+command %c -interaction=nonstopmode %f
+server %c
+output stdout
+prefix no
+rule 0 ! Missing \$ inserted.
+rule 1 ! Undefined control sequence.
+rule 2 LaTeX Warning
+rule 3 LaTeX Error
+rule 4 Overfull \\hbox
+default 5
+label 0 math mode error
+label 1 bad macro
+label 2 warning
+label 3 error
+label 4 bad box
+
+type ccServer
+command %c %f
+server %c
+output stderr
+prefix yes
+rule 1 error:
+label 1 errors
+EOF
+
+touch "$DIR/a.tex" "$DIR/b.tex" "$DIR/c.tex" "$DIR/a.c" "$DIR/b.c"
+touch "$DIR/a.java" "$DIR/b.java"
+
+# Stands in for java: checks it was given the server's source, then serves
+# the files with fakeCompiler
+mkdir "$DIR/bin" "$DIR/tmp"
+cat > "$DIR/bin/java" <<EOF
+#!/bin/sh
+case "\$1" in *.java) ;; *) exit 9 ;; esac
+grep -q "thresher-done" "\$1" || exit 9
+shift
+exec "$FAKECC" "\$@"
+EOF
+chmod +x "$DIR/bin/java"
+export FAKECC_LINES=40
+
+# Prints the result of a check
+# $1: the name of the check, $2: 0 if it passed
+check() {
+    if [ "$2" -eq 0 ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1"
+        FAILED=1
+    fi
+}
+
+# Runs thresher with the test rules from the temporary directory, saving
+# its output in $DIR/$1 and its exit status in $DIR/$1.status (124 if it
+# hung)
+# $1: the name to save the output as, then thresher's arguments
+run() {
+    name=$1
+    shift
+    (cd "$DIR" && timeout 30 "$THRESHER" --rules server.rules "$@") \
+            > "$DIR/$name" 2>&1
+    echo $? > "$DIR/$name.status"
+}
+
+# Gives the exit status saved by run
+# $1: the name the output was saved as
+status() {
+    cat "$DIR/$1.status"
+}
+
+# Each file gets the same table from the server as from its own run
+run alone texServer "$FAKECC" a.tex b.tex c.tex
+run served --server texServer "$FAKECC" a.tex b.tex c.tex
+cmp -s "$DIR/alone" "$DIR/served"
+check "server tables match separate runs" $?
+check "server run passes" "$(status served)"
+[ "$(grep -c "exited with status 0" "$DIR/served")" -eq 3 ]
+check "every served file has status 0" $?
+
+# The status the server gives for a file is its status, and stops the run
+run failed --server ccServer "$FAKECC" a.c b.c
+[ "$(status failed)" -eq 5 ]
+check "failed file fails the run" $?
+grep -q "a.c exited with status 1" "$DIR/failed"
+check "failed file has its status" $?
+! grep -q "b.c" "$DIR/failed"
+check "no file after the failed file is run" $?
+
+# A server that ends after each file is started again for the next one
+FAKECC_SERVE=1 run restarted --server texServer "$FAKECC" a.tex b.tex c.tex
+cmp -s "$DIR/alone" "$DIR/restarted"
+check "restarted server gives the same tables" $?
+check "restarted server run passes" "$(status restarted)"
+
+# A server that ends without thresher-done fails the file, even though it
+# exited with status 0
+run died --server texServer /bin/true a.tex b.tex
+[ "$(status died)" -eq 5 ]
+check "unanswered file fails the run" $?
+grep -q "a.tex got no answer from the compile server" "$DIR/died"
+check "unanswered file is reported" $?
+! grep -q "exited with status 0" "$DIR/died"
+check "unanswered file does not pass" $?
+
+# The java type's server is its source, run by the java on the PATH, and
+# the source is removed at the end of the run
+run javaAlone java "$FAKECC" a.java b.java
+PATH="$DIR/bin:$PATH" TMPDIR="$DIR/tmp" run javaServed --server java \
+        javac a.java b.java
+cmp -s "$DIR/javaAlone" "$DIR/javaServed"
+check "java server tables match separate runs" $?
+[ -z "$(ls "$DIR/tmp")" ]
+check "java server source is removed" $?
+
+exit $FAILED
@@ -0,0 +1,124 @@
+/**
+ * \file   spawnBench.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Measures what it costs thresher to start a compiler
+ *
+ * \details
+ *
+ * Usage: spawnBench [MB] [runs] [command]
+ *
+ * Fill MB megabytes of memory (default 0) so the process is as large as
+ * thresher would be inside a large parent, then start command (default
+ * true) runs times, first with fork and exec as create_child does and then
+ * with posix_spawn as spawn_child does, waiting for each to finish. Print
+ * the average time each start took in microseconds.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <spawn.h>
+#include <sys/time.h>
+
+#include "misc.h"
+
+//! The environment, passed on to the command
+extern char **environ;
+
+/**\details
+ * Gives the time in microseconds
+ *
+ * \return the current time in microseconds
+ */
+static double now(void) {
+
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+/**\details
+ * Starts the command with fork and exec and waits for it
+ *
+ * \param args (the command and its arguments, NULL terminated)
+ */
+static void run_fork(char **args) {
+
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        quit(ERR_SYS, 0);
+    } else if (pid == 0) {
+        execvp(args[0], args);
+        _exit(ERR_EXEC);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+/**\details
+ * Starts the command with posix_spawn and waits for it
+ *
+ * \param args (the command and its arguments, NULL terminated)
+ */
+static void run_spawn(char **args) {
+
+    pid_t pid;
+
+    if (posix_spawnp(&pid, args[0], NULL, NULL, args, environ)) {
+        quit(ERR_EXEC, 0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+/**\details
+ * Prints spawnBench's usage and exits with ERR_USAGE
+ */
+static void usage(void) {
+
+    fprintf(stderr, "Usage: spawnBench [MB] [runs] [command]\n");
+    exit(ERR_USAGE);
+}
+
+int main(int argc, char **argv) {
+
+    int megabytes = 0, runs = 200;
+    char *args[] = {"true", NULL};
+    char *memory;
+    double start, forkTime, spawnTime;
+
+    // A bench from a small process is asked for with 0 megabytes
+    if (argc > 1 && strcmp(argv[1], "0")
+            && !get_num_arg(argv[1], &megabytes)) {
+        usage();
+    }
+    if (argc > 2 && !get_num_arg(argv[2], &runs)) {
+        usage();
+    }
+    if (argc > 3) {
+        args[0] = argv[3];
+    }
+
+    // Touch every page so it has to be mapped into a forked child
+    memory = (char *) malloc((size_t) megabytes * 1024 * 1024 + 1);
+    memset(memory, 1, (size_t) megabytes * 1024 * 1024 + 1);
+
+    start = now();
+    for (int i = 0; i < runs; ++i) {
+        run_fork(args);
+    }
+    forkTime = (now() - start) / runs;
+
+    start = now();
+    for (int i = 0; i < runs; ++i) {
+        run_spawn(args);
+    }
+    spawnTime = (now() - start) / runs;
+
+    printf("%d MB, %d runs of %s\n", megabytes, runs, args[0]);
+    printf("fork and exec: %8.1f us per start\n", forkTime);
+    printf("posix_spawn:   %8.1f us per start\n", spawnTime);
+
+    free(memory);
+    return 0;
+}
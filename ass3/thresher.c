@@ -6,20 +6,157 @@
  * 
  * \details
  *
- * Usage: thresher [--show] type command filename ...
+ * Usage: thresher [--show] [-j jobs] [--cache dir] type command filename ...
  *
  * thresher is a program that summarises compiler outputs, with support for
  * ansiC, c99, java and latex (specified in type). The path to the program to
  * use is specified in command, and can summarise specified after command 
  * (seperated by spaces).
  *
+ * Compilers are started with posix_spawn; --fork uses fork and exec 
+ * instead.
+ *
+ * With --format json or --format csv, each file is printed as a record of
+ * its counts, exit status, wall time, CPU time and peak memory, rather 
+ * than as a table.
+ *
+ * With --watch, thresher keeps running. When files change, only those files
+ * are run again and every file's output is printed again, with the output
+ * of the unchanged files kept from before.
+ *
+ * With --top num, every file is run even if one fails, and then the num
+ * most common diagnostic messages across all of the files are printed,
+ * each with its count and the first place it was seen.
+ *
+ * With --json-diagnostics, types that can (ansiC and c99) ask gcc for its
+ * diagnostics as JSON, and each diagnostic is counted from its kind,
+ * message and location rather than from gcc's text. --show prints the
+ * line gcc would have printed for each one.
+ *
+ * With --syntax-only, types that can (ansiC and c99) only check each
+ * file's syntax, without generating code or writing any files. 
+ * --verify-syntax instead runs each file both ways and reports any file
+ * whose table or exit status is not the same, so a corpus can be checked
+ * before --syntax-only is relied on.
+ *
+ * With --nonstop, types that can (latex) are run without stopping for a
+ * reply at each error, and the log each run writes is counted once it has
+ * finished, giving the table the interactive run would have. A log left by
+ * an earlier run is removed first, so only this run's log is counted. The
+ * logs are written in the working directory, so with -j no two files may
+ * have the same name (like a/x.tex and b/x.tex).
+ *
+ * With --server, types with a server template (java, or from a rule file,
+ * see server.h) start their compiler once as a compile server, and send
+ * it each file in turn down a pipe, so a compiler with a slow start (like
+ * javac's JVM) only starts once. A file the server ends without answering
+ * is sent to a new server, and fails if that one ends too.
+ *
+ * With --max-errors num, the compiler is killed as soon as num diagnostics
+ * have been counted for a file, and the file is reported as stopped and
+ * bad without waiting for the rest of its output. --fail-fast stops at the
+ * first.
+ *
+ * With --timeout secs, a compiler still running after secs seconds is 
+ * killed, along with anything it started. --cpu-limit secs and --mem-limit
+ * MB set the CPU time and memory each compiler process may use. A file 
+ * whose compiler is killed is reported as timed out or over its CPU limit
+ * in place of its exit status (a compiler out of memory fails as it would
+ * have anyway).
+ *
+ * With --batch num, up to num files are given to each run of the compiler
+ * (for build types with a batch command), and its output is split back
+ * into a table for each file by the file names at the start of its lines.
+ * A failed run fails the files with errors, or all of them if none do.
+ * The C types' batches only check the files and are not linked, so their
+ * tables leave out link errors (like an undefined reference to a missing
+ * function) that a single file's run would have counted.
+ *
+ * With -j jobs, up to jobs files are summarised at once. The output is 
+ * still printed in the order the files were given. Under make -j, each
+ * compiler after the first waits for a token from make's jobserver, so
+ * thresher never runs more jobs than make allows.
+ *
+ * With --history file, how long each file took is saved in file, and with
+ * -j the files expected to take longest are started first (new files are
+ * guessed from their size), so a large file given last does not hold up
+ * the end of the run. The output is in the order the files were given.
+ *
+ * With --log logfile, the compiler is not run. Instead the output already
+ * saved in the logs (- for stdin) is summarised for each file, using
+ * -j threads.
+ *
+ * With --cache dir, each file's output is saved in dir under a hash of the
+ * file, the command and the type, and replayed without running the 
+ * compiler if none of them have changed. dir is made if it does not 
+ * exist. --cache-size sets the most MB the cache keeps, removing the least
+ * recently used results.
+ *
+ * With --daemon socket, thresher stays running and serves requests sent to
+ * the Unix socket, with no more than -j jobs compilers running at once
+ * across all of them. The built in types and any --rules files given to
+ * the daemon are loaded once, rather than for each request. thresher
+ * --connect socket followed by the usual arguments sends them to the
+ * daemon, along with the environment and stdin, and behaves as thresher
+ * would have.
+ *
  * All commenting is designed to be compatible with Doxygen.
  */
 
-#include "thresherSupport.h"
+#include "daemon.h"
+#include "logs.h"
+#include "pool.h"
+#include "watch.h"
+#include "batch.h"
+#include "verify.h"
+#include "server.h"
 
 int main(int argc, char** argv) {
 
+    int jobs = 0;
+
+    // Serve requests on a socket rather than running anything
+    if (argc > 1 && !strcmp(argv[1], "--daemon")) {
+        if (argc < 3) {
+            quit(ERR_USAGE, 0);
+        }
+
+        // The rules are loaded and compiled once, for every request
+        rules_load_builtin();
+        for (int i = 3; i < argc; i += 2) {
+            if (i + 1 >= argc) {
+                quit(ERR_USAGE, 0);
+            } else if (!strcmp(argv[i], "-j")) {
+                if (!get_num_arg(argv[i + 1], &jobs)) {
+                    quit(ERR_USAGE, 0);
+                }
+            } else if (!strcmp(argv[i], "--rules")) {
+                rules_load_file(argv[i + 1]);
+            } else {
+                quit(ERR_USAGE, 0);
+            }
+        }
+        rules_compile();
+
+        daemon_run(argv[2], jobs);
+    }
+
+    // Hand the rest of the arguments to a daemon
+    if (argc > 1 && !strcmp(argv[1], "--connect")) {
+        if (argc < 3) {
+            quit(ERR_USAGE, 0);
+        }
+        return daemon_connect(argv[2], argc - 3, &argv[3]);
+    }
+
+    // Share make's job slots rather than adding to them
+    token_jobserver();
+
+    return thresher_run(argc, argv);
+}
+
+int thresher_run(int argc, char **argv) {
+
     //Set childPid (global variable)
     childPid = 0;
 
@@ -28,43 +165,61 @@ int main(int argc, char** argv) {
 
     // Sets up thresher to handle SIGINT signals.
     struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
     sa.sa_handler = sigint_recieved;
     sa.sa_flags = SA_RESTART;
     sigaction(SIGINT, &sa, 0);
 
-    //Sets the type, show, and cmd values
-    ts.type = arg_handler(argc, argv, &ts.show);
-    ts.cmd = argv[2 + ts.show];
+    //Sets the type, show, jobs, logs and cmd values
+    int first = arg_handler(argc, argv, &ts);
+
+    // Keep running the files as they change
+    if (ts.watch) {
+        watch_run(&ts, &argv[first], argc - first);
+    }
+
+    // CSV output starts with the names of the columns
+    report_header(ts.build);
+
+    // Summarise the logs if any were given rather than running anything
+    if (ts.logs) {
+        log_run(&ts, &argv[first], argc - first);
+        return 0;
+    }
+
+    // Compare syntax only runs with full compiles rather than summarising
+    if (ts.verify) {
+        verify_run(&ts, &argv[first], argc - first);
+        return 0;
+    }
+
+    // Run the files through the pool if more than one job is allowed, if
+    // results are cached (the pool keeps each file's output) or if the 
+    // diagnostics of every file are counted (the pool collects them) or
+    // if their times are kept (the pool times them)
+    if (ts.jobs > 1 || ts.cacheDir || ts.top || ts.history) {
+        pool_run(&ts, &argv[first], argc - first);
+        return 0;
+    }
+
+    if (ts.server) {
+        server_run(&ts, &argv[first], argc - first);
+        return 0;
+    }
+
+    if (ts.batch > 1) {
+        batch_run(&ts, &argv[first], argc - first);
+        return 0;
+    }
 
     // Loop across all files given in arguments
-    for (int i = 3 + ts.show; i < argc; ++i) { 
+    for (int i = first; i < argc; ++i) { 
 
         // Get the current file
         ts.curFile = argv[i];
 
-        // Create the pipes, throwing an error if the system call fails
-        if (pipe(ts.childError) || pipe(ts.childInput) 
-                || pipe(ts.childOutput)) {
-            quit(ERR_SYS, ts.show + 2);
-        }
-
-        // Fork and grab the pid (modify childPid global)
-        // -1 failed, 0 child, otherwise parent.
-        ts.pid = fork();
-        switch (childPid = ts.pid) {
-            // There was an error with fork(), quit and tell the user
-            case -1:
-                quit(ERR_SYS, ts.show+2);
-                break;
-            // Create the child
-            case 0:
-                create_child(&ts);
-                break;
-            // Create the parent
-            default:
-                create_parent(&ts);
-                break;
-        }
+        // Run the compiler on the file and summarise it
+        thresh_file(&ts);
     }
     return 0;
 }
\ No newline at end of file
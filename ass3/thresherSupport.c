@@ -13,43 +13,522 @@
  * All commenting is designed to be compatible with Doxygen.
  */
 
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/resource.h>
+
 #include "thresherSupport.h"
+#include "cache.h"
+#include "batch.h"
+#include "jsonDiag.h"
+#include "logs.h"
 
-int arg_handler(int argc, char** argv, int *show) {
+//! The environment, passed on to the compiler by posix_spawn
+extern char **environ;
 
-    int type;
+pid_t childPid;
 
-    // See if the "--show" argument has been set
-    if (argc > 1 && !strcmp(argv[1], "--show")) {
-        *show = 1;
-    } else {
-        *show = 0;
+//! Boolean for the child having been killed at the timeout
+static volatile sig_atomic_t childTimedOut;
+
+//! Why a child was stopped, as the table says it then as a record does
+static const char *stoppedReasons[][2] = {
+        {"was stopped early", "max-errors"},
+        {"timed out", "timeout"},
+        {"got no answer from the compile server", "server-died"},
+        {"went over its CPU limit", "cpu-limit"}
+};
+
+/**\details
+ * Checks if two of the files would have a nonstop compiler write the same
+ * log, as files with the same name in different directories do
+ *
+ * \param ts (ThresherStruct with the build type set)
+ * \param files (the files to summarise)
+ * \param numFiles (the number of files)
+ *
+ * \return 1 if two of the files share a log, else 0
+ */
+static int logs_shared(ThresherStruct *ts, char **files, int numFiles) {
+
+    char **paths = (char **) malloc(sizeof(char *) * (numFiles + 1));
+    int shared = 0;
+
+    for (int i = 0; i < numFiles; ++i) {
+        paths[i] = rules_log_path(ts->build, files[i]);
+        for (int j = 0; j < i && !shared; ++j) {
+            shared = !strcmp(paths[i], paths[j]);
+        }
+    }
+
+    for (int i = 0; i < numFiles; ++i) {
+        free(paths[i]);
+    }
+    free(paths);
+
+    return shared;
+}
+
+/**\details
+ * Checks that the options given to thresher can be used together
+ *
+ * \param ts (ThresherStruct with the options set)
+ *
+ * \return 1 if any of the options can't be used together, else 0
+ */
+static int bad_options(ThresherStruct *ts) {
+
+    int limits = ts->timeout || ts->cpuLimit || ts->memLimit;
+
+    // The compiler's output is not mixed into records
+    if (ts->show && outputFormat != FORMAT_TEXT) {
+        return 1;
     }
 
-    // Check that the minimum number of arguments have been given.
-    if (argc < 4 + *show) {
+    // Logs don't change, so are not watched, and are text, so are not read
+    // as JSON or checked for syntax
+    if (ts->logs && (ts->watch || ts->jsonDiags || ts->syntaxOnly 
+            || ts->verify)) {
+        return 1;
+    }
+
+    // --top reports every file's diagnostics once, and none are replayed
+    // from the cache
+    if (ts->top && (ts->watch || ts->cacheDir 
+            || outputFormat != FORMAT_TEXT)) {
+        return 1;
+    }
+
+    // Batches are only run one at a time, without the cache
+    if (ts->batch > 1 && (ts->jobs > 1 || ts->cacheDir || ts->top
+            || ts->watch || ts->logs || ts->jsonDiags)) {
+        return 1;
+    }
+
+    // --verify-syntax prints its own report, so runs on its own
+    if (ts->verify && (ts->syntaxOnly || ts->show || ts->watch || ts->top 
+            || ts->cacheDir || ts->batch > 1 || ts->jobs > 1 
+            || ts->useFork || outputFormat != FORMAT_TEXT)) {
+        return 1;
+    }
+
+    // A nonstop run's log is counted for one file at a time
+    if (ts->nonstop && (ts->logs || ts->batch > 1 || ts->jsonDiags
+            || ts->verify)) {
+        return 1;
+    }
+
+    // The one compile server is given every file, in order
+    if (ts->server && (ts->logs || ts->batch > 1 || ts->jobs > 1
+            || ts->cacheDir || ts->top || ts->watch || ts->useFork 
+            || ts->jsonDiags || ts->nonstop || ts->verify)) {
+        return 1;
+    }
+
+    // Only a compiler running for one file is stopped at --max-errors
+    if (ts->maxErrors && (ts->logs || ts->batch > 1 || ts->server 
+            || ts->nonstop || ts->verify)) {
+        return 1;
+    }
+
+    // --history only times the pool's workers
+    if (ts->history && (ts->logs || ts->watch || ts->batch > 1 
+            || ts->server || ts->verify)) {
+        return 1;
+    }
+
+    // Limits are only set on a compiler running for one file
+    if (limits && (ts->logs || ts->batch > 1 || ts->server 
+            || ts->verify)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int arg_handler(int argc, char** argv, ThresherStruct *ts) {
+
+    int i = 1;
+
+    ts->show = 0;
+    ts->useFork = 0;
+    ts->watch = 0;
+    ts->top = 0;
+    ts->diagFd = -1;
+    diag_init(&ts->diags);
+    ts->jobs = 0;
+    ts->logs = NULL;
+    ts->numLogs = 0;
+    ts->cacheDir = NULL;
+    ts->cacheSize = CACHE_DEFAULT_SIZE;
+    ts->batch = 0;
+    ts->batchFiles = NULL;
+    ts->batchSize = 0;
+    ts->jsonDiags = 0;
+    ts->syntaxOnly = 0;
+    ts->verify = 0;
+    ts->nonstop = 0;
+    ts->server = 0;
+    ts->serverDied = 0;
+    ts->serverSource = NULL;
+    ts->maxErrors = 0;
+    ts->truncated = 0;
+    ts->history = NULL;
+    ts->timeout = 0;
+    ts->cpuLimit = 0;
+    ts->memLimit = 0;
+    ts->overCpu = 0;
+    ts->worker = 0;
+
+    // Rule files given in the options can add to or replace these
+    rules_load_builtin();
+
+    // Read the options given before the type
+    while (i < argc) {
+        if (!strcmp(argv[i], "--show")) {
+            ts->show = 1;
+        } else if (!strcmp(argv[i], "--format")) {
+            if (i + 1 >= argc) {
+                quit(ERR_USAGE, 0);
+            } else if (!strcmp(argv[i + 1], "json")) {
+                outputFormat = FORMAT_JSON;
+            } else if (!strcmp(argv[i + 1], "csv")) {
+                outputFormat = FORMAT_CSV;
+            } else {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--top")) {
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &ts->top)) {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--batch")) {
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &ts->batch)) {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--json-diagnostics")) {
+            ts->jsonDiags = 1;
+        } else if (!strcmp(argv[i], "--syntax-only")) {
+            ts->syntaxOnly = 1;
+        } else if (!strcmp(argv[i], "--verify-syntax")) {
+            ts->verify = 1;
+        } else if (!strcmp(argv[i], "--nonstop")) {
+            ts->nonstop = 1;
+        } else if (!strcmp(argv[i], "--server")) {
+            ts->server = 1;
+        } else if (!strcmp(argv[i], "--max-errors")) {
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &ts->maxErrors)) {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--history")) {
+            if (i + 1 >= argc) {
+                quit(ERR_USAGE, 0);
+            }
+            ts->history = argv[++i];
+        } else if (!strcmp(argv[i], "--timeout")) {
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &ts->timeout)) {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--cpu-limit")) {
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &ts->cpuLimit)) {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--mem-limit")) {
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &ts->memLimit)) {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--fail-fast")) {
+            ts->maxErrors = 1;
+        } else if (!strcmp(argv[i], "--watch")) {
+            ts->watch = 1;
+        } else if (!strcmp(argv[i], "--fork")) {
+            ts->useFork = 1;
+        } else if (!strcmp(argv[i], "-j")) {
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &ts->jobs)) {
+                quit(ERR_USAGE, 0);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "--rules")) {
+            if (i + 1 >= argc) {
+                quit(ERR_USAGE, 0);
+            }
+            rules_load_file(argv[++i]);
+        } else if (!strcmp(argv[i], "--log")) {
+            if (i + 1 >= argc) {
+                quit(ERR_USAGE, 0);
+            }
+            ts->logs = (char **) realloc(ts->logs, 
+                    sizeof(char *) * (ts->numLogs + 1));
+            ts->logs[ts->numLogs++] = argv[++i];
+        } else if (!strcmp(argv[i], "--cache")) {
+            if (i + 1 >= argc) {
+                quit(ERR_USAGE, 0);
+            }
+            ts->cacheDir = argv[++i];
+        } else if (!strcmp(argv[i], "--cache-size")) {
+            int size;
+
+            if (i + 1 >= argc || !get_num_arg(argv[i + 1], &size)) {
+                quit(ERR_USAGE, 0);
+            }
+            ts->cacheSize = (long) size * 1024 * 1024;
+            i++;
+        } else {
+            break;
+        }
+        i++;
+    }
+
+    // Check that the type, command (unless logs are given) and a file are
+    // left, and that the options can be used together
+    if (argc < i + (ts->logs ? 2 : 3) || bad_options(ts)) {
         quit(ERR_USAGE, 0);
     }
 
-    // Set the type for thresher: 0 ansiC, 1 c99, 2 java, 3 latex
-    if (!strcmp(argv[1+*show], "ansiC")) {
-        type = ANSIC;
-    } else if (!strcmp(argv[1+*show], "c99")) {
-        type = CNN;
-    } else if (!strcmp(argv[1+*show], "java")) {
-        type = JAVA;
-    } else if (!strcmp(argv[1+*show], "latex")) {
-        type = LATEX;
-    } else {
+    // Every store would fail without the cache's directory
+    if (ts->cacheDir) {
+        cache_init(ts);
+    }
+
+    // posix_spawn can't set the compiler's limits, so the child sets them
+    if (ts->cpuLimit || ts->memLimit) {
+        ts->useFork = 1;
+    }
+
+    // Compile every build type's patterns once, before any file is run
+    rules_compile();
+
+    // Set the type for thresher: 0 ansiC, 1 c99, 2 java, 3 latex, then any
+    // types from rule files
+    if ((ts->type = rules_find(argv[i])) == -1) {
         quit(ERR_UNKNOWN, 0);
     }
+    ts->build = &buildTypes[ts->type];
+
+    // Logs are summarised without running a command
+    if (ts->logs) {
+        ts->cmd = NULL;
+        return i + 1;
+    }
 
-    return type;
+    ts->cmd = argv[i + 1];
+
+    // Jobs run in the same directory, so two of their files with the same
+    // name would write (and count) the same log
+    if (ts->nonstop && ts->build->nonstop && ts->jobs > 1 
+            && logs_shared(ts, &argv[i + 2], argc - i - 2)) {
+        quit(ERR_USAGE, 0);
+    }
+
+    return i + 2;
+}
+
+/**\details
+ * Kills the child's process group once the timeout has passed, for SIGALRM
+ *
+ * \param childPid global variable used
+ * \param s (The signal number that cauased the function to be called)
+ */
+static void timeout_recieved(int s) {
+
+    if (childPid) {
+        childTimedOut = 1;
+        kill(-childPid, SIGKILL);
+    }
+}
+
+/**\details
+ * Starts the timeout for the child that has just been started
+ *
+ * \param ts (ThresherStruct with initialised values)
+ */
+static void start_timeout(ThresherStruct *ts) {
+
+    struct sigaction sa;
+
+    childTimedOut = 0;
+    if (!ts->timeout) {
+        return;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = timeout_recieved;
+    sigaction(SIGALRM, &sa, 0);
+    alarm(ts->timeout);
+}
+
+void thresh_file(ThresherStruct *ts) {
+
+    // A nonstop compiler's log is counted once it has finished, so a log
+    // left by an earlier run must not be counted in place of its own
+    if (ts->nonstop && ts->build->nonstop) {
+        char *path = rules_log_path(ts->build, ts->curFile);
+
+        unlink(path);
+        free(path);
+    }
+
+    // Create the pipes, throwing an error if the system call fails
+    if (pipe(ts->childError) || pipe(ts->childInput) 
+            || pipe(ts->childOutput) || pipe(ts->childOther)) {
+        quit(ERR_SYS, ts->show + 2);
+    }
+
+    // Wait until another compiler may be run
+    token_acquire();
+    ts->started = report_now();
+
+    // Spawn the compiler without copying thresher, unless asked to fork
+    if (!ts->useFork) {
+        spawn_child(ts);
+        start_timeout(ts);
+        if (ts->batchSize) {
+            batch_parent(ts);
+        } else {
+            create_parent(ts);
+        }
+        return;
+    }
+
+    // Fork and grab the pid (modify childPid global)
+    // -1 failed, 0 child, otherwise parent.
+    ts->pid = fork();
+    switch (childPid = ts->pid) {
+        // There was an error with fork(), quit and tell the user
+        case -1:
+            quit(ERR_SYS, ts->show+2);
+            break;
+        // Create the child
+        case 0:
+            create_child(ts);
+            break;
+        // Create the parent, with the child in its own process group if it
+        // may need to be killed at the timeout (set here as well, so it is
+        // before the timer can fire)
+        default:
+            if (ts->timeout) {
+                setpgid(ts->pid, ts->pid);
+            }
+            start_timeout(ts);
+            if (ts->batchSize) {
+                batch_parent(ts);
+            } else {
+                create_parent(ts);
+            }
+            break;
+    }
+}
+
+/**\details
+ * Gives the child's output stream that the build type does not parse
+ *
+ * \param bt (the build type)
+ *
+ * \return stderr's file descriptor for stdout build types, otherwise 
+ * stdout's
+ */
+static int other_stream(BuildType *bt) {
+
+    return bt->output == STDOUT_FILENO ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+/**\details
+ * Builds the arguments to run the compiler with, on every file of the batch
+ * if there is one, as a compile server if server is set and the build type
+ * has one, and on ts->curFile otherwise (asking for JSON if 
+ * jsonDiags is set, without stopping for replies if nonstop is set and 
+ * only checking syntax if syntaxOnly is set, where the build type can)
+ *
+ * \param ts (ThresherStruct with initialised values)
+ *
+ * \return the arguments, NULL terminated, free with free()
+ */
+static char **child_args(ThresherStruct *ts) {
+
+    char **args;
+
+    if (ts->batchSize) {
+        args = rules_batch_args(ts->build, ts->cmd, ts->batchFiles, 
+                ts->batchSize);
+    } else if (ts->server && ts->build->server) {
+        args = rules_server_args(ts->build, ts->cmd, ts->serverSource);
+    } else if (ts->jsonDiags && ts->build->json) {
+        args = rules_json_args(ts->build, ts->cmd, ts->curFile);
+    } else if (ts->nonstop && ts->build->nonstop) {
+        args = rules_nonstop_args(ts->build, ts->cmd, ts->curFile);
+    } else {
+        args = rules_args(ts->build, ts->cmd, ts->curFile);
+    }
+
+    // Leave out code generation if only the diagnostics are needed
+    if (ts->syntaxOnly && ts->build->syntax) {
+        args = rules_syntax_args(ts->build, args);
+    }
+    return args;
+}
+
+void spawn_child(ThresherStruct *ts) {
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    char **args = child_args(ts);
+    int error;
+
+    // The same pipes as create_child: the input pipe replaces stdin, the 
+    // output pipe replaces the build type's output stream, the other pipe
+    // replaces the other stream and the other ends are closed.
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, ts->childInput[READ], 
+            STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, ts->childOutput[WRITE], 
+            ts->build->output);
+    posix_spawn_file_actions_adddup2(&actions, ts->childOther[WRITE], 
+            other_stream(ts->build));
+    for (int i = 0; i < 2; ++i) {
+        posix_spawn_file_actions_addclose(&actions, ts->childError[i]);
+        posix_spawn_file_actions_addclose(&actions, ts->childInput[i]);
+        posix_spawn_file_actions_addclose(&actions, ts->childOutput[i]);
+        posix_spawn_file_actions_addclose(&actions, ts->childOther[i]);
+    }
+
+    // A compiler that may time out gets its own process group, so anything
+    // it starts is killed with it
+    posix_spawnattr_init(&attr);
+    if (ts->timeout) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+
+    error = posix_spawnp(&ts->pid, args[0], &actions, &attr, args, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    free(args);
+
+    if (error) {
+        // Nothing was started, so give the same output as a failed exec
+        childPid = 0;
+        if (outputFormat == FORMAT_TEXT) {
+            printf("----\n");
+            if (ts->show) {
+                printf("----\n");
+            }
+        }
+        quit(ERR_EXEC, 1);
+    }
+
+    childPid = ts->pid;
 }
 
 void create_child(ThresherStruct *ts) {
 
     FILE *errPipe;
+    char **args;
 
     // Set up the error pipe
     errPipe = fdopen(ts->childError[WRITE], "w");
@@ -60,68 +539,263 @@ void create_child(ThresherStruct *ts) {
         child_quit(errPipe, ERR_SYS);
     }
 
-    // If latex, replace stdout with the output pipe. Otherwise, replace 
-    // stderr. If any of these fail, tell the parent then quit. 
-    if (ts->type == LATEX && 
-            dup2(ts->childOutput[WRITE], STDOUT_FILENO) == -1) {
-        child_quit(errPipe, ERR_SYS);
-    } 
-    
-    if (ts->type != LATEX && 
-            dup2(ts->childOutput[WRITE], STDERR_FILENO) == -1) {
+    // Replace the build type's output stream (stdout for latex, stderr
+    // otherwise) with the output pipe, and the other stream with the other
+    // pipe. If this fails, tell the parent then quit. 
+    if (dup2(ts->childOutput[WRITE], ts->build->output) == -1
+            || dup2(ts->childOther[WRITE], other_stream(ts->build)) == -1) {
         child_quit(errPipe, ERR_SYS);
     }
 
     // Close the other ends of the pipe. If close fails, tell parent and quit.
     if (close(ts->childError[READ]) || close(ts->childInput[WRITE]) 
-            || close(ts->childOutput[READ])) {
+            || close(ts->childOutput[READ]) || close(ts->childOther[READ])) {
         child_quit(errPipe, ERR_SYS);
     }
-    
-    // Exec the program depending on the type
-    // 0 ansiC, 1 c99, 2 java, 3 latex
-    switch (ts->type) {
-        case ANSIC:
-            execlp(ts->cmd, ts->cmd, "-ansi", "-pedantic", "-Wall", 
-                    ts->curFile, (char *) NULL);
-            break;
-        case CNN:
-            execlp(ts->cmd, ts->cmd, "-std=gnu99", "-pedantic", "-Wall", 
-                    ts->curFile, (char *) NULL);
-            break;
-        case JAVA:
-            execlp(ts->cmd, ts->cmd, "-d", ".", ts->curFile, (char *) NULL);
-            break;
-        case LATEX:
-            execlp(ts->cmd, ts->cmd, ts->curFile, (char *) NULL);
-            break;
+
+    // Start a process group that can be killed at the timeout, and set the
+    // limits. Going over the soft CPU limit sends SIGXCPU, and the hard 
+    // limit a second later SIGKILL.
+    if (ts->timeout && setpgid(0, 0)) {
+        child_quit(errPipe, ERR_SYS);
     }
+    if (ts->cpuLimit) {
+        struct rlimit limit = {ts->cpuLimit, ts->cpuLimit + 1};
+
+        if (setrlimit(RLIMIT_CPU, &limit)) {
+            child_quit(errPipe, ERR_SYS);
+        }
+    }
+    if (ts->memLimit) {
+        struct rlimit limit = {(rlim_t) ts->memLimit << 20, 
+                (rlim_t) ts->memLimit << 20};
+
+        if (setrlimit(RLIMIT_AS, &limit)) {
+            child_quit(errPipe, ERR_SYS);
+        }
+    }
+    
+    // Exec the program with the build type's command
+    args = child_args(ts);
+    execvp(args[0], args);
 
     // If this point has been reached, exec has failed. 
     child_quit(errPipe, ERR_EXEC);
 }
 
-void create_parent(ThresherStruct *ts) {
+/**\details
+ * Writes as many of the waiting replies as the child's stdin will take
+ * without blocking, dropping them if nothing can take them
+ *
+ * \param io (the pipes of the child)
+ */
+static void write_replies(ChildIO *io) {
 
-    FILE *errPipe, *writePipe, *readPipe;
-    int table[7];
+    ssize_t count;
+
+    if (io->in == -1) {
+        io->replies.len = 0;
+        return;
+    }
+
+    while (io->replies.len) {
+        if ((count = write(io->in, io->replies.data, io->replies.len)) > 0) {
+            memmove(io->replies.data, io->replies.data + count, 
+                    io->replies.len - count);
+            io->replies.len -= count;
+        } else if (count == -1 && errno == EINTR) {
+            continue;
+        } else {
+            return;
+        }
+    }
+}
+
+/**\details
+ * Reads what is waiting on one of the child's pipes, closing it at the end
+ * of input
+ *
+ * \param fd (the pipe, set to -1 if closed)
+ * \param into (buffer to add what was read to, or NULL)
+ * \param forward (stream to print what was read to, or NULL)
+ */
+static void read_pipe(int *fd, Buffer *into, FILE *forward) {
+
+    char buffer[4096];
+    ssize_t count;
+
+    while ((count = read(*fd, buffer, sizeof(buffer))) != 0) {
+        if (count > 0) {
+            if (into) {
+                buffer_append(into, buffer, count);
+            }
+            if (forward) {
+                fwrite(buffer, 1, count, forward);
+            }
+        } else if (errno != EINTR) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            break;
+        }
+    }
+
+    close(*fd);
+    *fd = -1;
+}
+
+/**\details
+ * Waits for any of the child's pipes to be ready, and deals with the ones
+ * that are other than the output pipe
+ *
+ * \param io (the pipes of the child)
+ * \param withOut (boolean for waiting on the output pipe too)
+ */
+static void poll_child(ChildIO *io, int withOut) {
+
+    struct pollfd fds[4];
+    int numFds = 0;
+
+    if (withOut) {
+        fds[numFds].fd = io->out.fd;
+        fds[numFds++].events = POLLIN;
+    }
+    fds[numFds].fd = io->err;
+    fds[numFds++].events = POLLIN;
+    fds[numFds].fd = io->other;
+    fds[numFds++].events = POLLIN;
+    fds[numFds].fd = io->replies.len ? io->in : -1;
+    fds[numFds++].events = POLLOUT;
+
+    // Negative fds are skipped by poll
+    if (poll(fds, numFds, -1) == -1) {
+        if (errno == EINTR) {
+            return;
+        }
+        quit(ERR_SYS, 0);
+    }
+
+    if (io->err != -1 && fds[numFds - 3].revents) {
+        read_pipe(&io->err, &io->errors, NULL);
+    }
+    if (io->other != -1 && fds[numFds - 2].revents) {
+        read_pipe(&io->other, NULL, io->forward);
+    }
+    if (fds[numFds - 1].revents & (POLLERR | POLLHUP)) {
+        close(io->in);
+        io->in = -1;
+    } else if (fds[numFds - 1].revents) {
+        write_replies(io);
+    }
+}
+
+/**\details
+ * Makes a file descriptor non-blocking
+ *
+ * \param fd (the file descriptor)
+ *
+ * \return 0 on success, -1 on failure
+ */
+static int set_nonblocking(int fd) {
+
+    int flags = fcntl(fd, F_GETFL);
+
+    return flags == -1 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+void child_io_init(ThresherStruct *ts, ChildIO *io) {
+
+    memset(io, 0, sizeof(ChildIO));
+    reader_init(&io->out, ts->childOutput[READ]);
+    io->err = ts->childError[READ];
+    io->other = ts->childOther[READ];
+    io->in = ts->childInput[WRITE];
+
+    // Print the other stream where the child would have, unless that would
+    // mix it into the records
+    io->forward = other_stream(ts->build) == STDERR_FILENO
+            || outputFormat != FORMAT_TEXT ? stderr : stdout;
 
-    // Set up the pipes so the parent can interact with the child
-    errPipe = fdopen(ts->childError[READ], "r");
-    writePipe = fdopen(ts->childInput[WRITE], "w");
-    readPipe = fdopen(ts->childOutput[READ], "r");
-    
     // Close the other ends of the pipes
     if (close(ts->childError[WRITE]) || close(ts->childInput[READ]) 
-            || close(ts->childOutput[WRITE])) {
-        quit(ERR_SYS, ts->show+2);
+            || close(ts->childOutput[WRITE]) || close(ts->childOther[WRITE])
+            || set_nonblocking(io->out.fd) || set_nonblocking(io->err)
+            || set_nonblocking(io->other) || set_nonblocking(io->in)) {
+        quit(ERR_SYS, ts->show + 2);
+    }
+}
+
+int child_io_next(ChildIO *io, char **buffer, size_t *len) {
+
+    int result;
+
+    // The child may be waiting on a reply to the last line
+    write_replies(io);
+
+    while ((result = reader_next(&io->out, buffer, len)) == -1) {
+        poll_child(io, 1);
     }
 
-    printf("----\n");
+    return result;
+}
+
+void child_io_finish(ChildIO *io) {
+
+    // The output has ended, so nothing is waiting on a reply
+    io->replies.len = 0;
+    if (io->in != -1) {
+        close(io->in);
+        io->in = -1;
+    }
+
+    while (io->err != -1 || io->other != -1) {
+        poll_child(io, 0);
+    }
+}
+
+void child_io_free(ChildIO *io) {
+
+    reader_free(&io->out);
+    if (io->out.fd != -1) {
+        close(io->out.fd);
+    }
+    if (io->err != -1) {
+        close(io->err);
+    }
+    if (io->other != -1) {
+        close(io->other);
+    }
+    if (io->in != -1) {
+        close(io->in);
+    }
+    free(io->errors.data);
+    free(io->replies.data);
+}
+
+void create_parent(ThresherStruct *ts) {
+
+    ChildIO io;
+    struct rusage usage;
+    int table[7];
+
+    // Set up the pipes so the parent can interact with the child
+    child_io_init(ts, &io);
+
+    if (outputFormat == FORMAT_TEXT) {
+        printf("----\n");
+    }
 
     // Parse the values outputted by the child, and construct a table of
     // errors (table) depending on the type;
-    parse_child(ts, table, writePipe, readPipe);
+    parse_child(ts, table, &io);
+    child_io_finish(&io);
+
+    // A worker sends the diagnostics it counted back to the pool
+    if (ts->diagFd != -1) {
+        diag_write(&ts->diags, ts->diagFd);
+        close(ts->diagFd);
+        ts->diagFd = -1;
+    }
 
     // If show is enabled, end the buffer printing
     if (ts->show) {
@@ -129,99 +803,376 @@ void create_parent(ThresherStruct *ts) {
     }
     
     // Check if the child sent any errors through the error pipe
-    parse_child_error(errPipe);
+    parse_child_error(&io);
 
-    // Wait until the child has completed and grab its error value
-    waitpid(ts->pid, &table[6], 0);
+    // Wait until the child has completed and grab its error value and 
+    // resource usage
+    wait4(ts->pid, &table[6], 0, &usage);
+    alarm(0);
 
     // Clear childPid (global variable) for the signal handler
     childPid = 0;
+    token_release();
 
     // Build the table coresponding to the type (and the values parsed)
-    build_table(ts, table);
+    build_table(ts, table, &usage);
 
-    printf("----\n");
+    if (outputFormat == FORMAT_TEXT) {
+        printf("----\n");
+    }
 
     // Close the open files
-    fclose(readPipe);
-    fclose(writePipe);
-    fclose(errPipe);
+    child_io_free(&io);
 }
 
-void parse_child(ThresherStruct *ts, int table[], FILE *writePipe, 
-        FILE *readPipe) {
+void run_child(ThresherStruct *ts, int table[]) {
+
+    ChildIO io;
+
+    if (pipe(ts->childError) || pipe(ts->childInput) 
+            || pipe(ts->childOutput) || pipe(ts->childOther)) {
+        quit(ERR_SYS, 0);
+    }
+
+    token_acquire();
+    spawn_child(ts);
+    child_io_init(ts, &io);
+
+    parse_child(ts, table, &io);
+    child_io_finish(&io);
+    parse_child_error(&io);
+
+    waitpid(ts->pid, &table[6], 0);
+    childPid = 0;
+    token_release();
+
+    child_io_free(&io);
+}
+
+/**\details
+ * Checks if a line is a compiler driver saying the CPU limit killed a 
+ * program it ran, as in gcc's "gcc: fatal error: CPU time limit exceeded
+ * signal terminated program cc1" (or "Killed signal" for SIGKILL)
+ *
+ * \param buffer (the line)
+ *
+ * \return the signal the line says killed the program, or 0
+ */
+static int over_cpu_line(const char *buffer) {
+
+    const int signals[] = {SIGXCPU, SIGKILL};
+    char text[256];
+
+    for (int i = 0; i < 2; ++i) {
+        snprintf(text, sizeof(text), "%s signal terminated program",
+                strsignal(signals[i]));
+        if (strstr(buffer, text)) {
+            return signals[i];
+        }
+    }
+
+    return 0;
+}
+
+/** \struct LineContext
+ *  \brief What parse_json_diag needs to count each JSON diagnostic
+ */
+typedef struct {
+    ThresherStruct *ts;     /**< The ThresherStruct of the child */
+    int *table;             /**< The table being counted */
+    ChildIO *io;            /**< The pipes of the child */
+} LineContext;
+
+/**\details
+ * Parses one line of the child's output into the table
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param table (int table of size 7, value is modified by the function)
+ * \param io (the pipes of the child, replies are added)
+ * \param buffer (the line, terminated)
+ * \param len (the length of the line)
+ */
+static void parse_line(ThresherStruct *ts, int table[], ChildIO *io,
+        char *buffer, size_t len) {
+
+    int category;
+
+    // If show is enabled, print the buffer
+    if (ts->show) {
+        printf("%s\n", buffer);
+    }
+
+    // A driver says so when the CPU limit killed a program it ran
+    if (ts->cpuLimit && !ts->overCpu) {
+        ts->overCpu = over_cpu_line(buffer);
+    }
+
+    // Grab the parse value (corresponding to an error entered on the
+    // table) under the build type's rules. Increase the value of the 
+    // entry in the table.
+    category = rules_parse(ts->build, &buffer, len, ts->curFile, 
+            &io->replies);
+    table[category]++;
+
+    // Count the diagnostic itself for --top
+    if (ts->top && ts->build->labels[category]) {
+        diag_add_line(&ts->diags, ts->build, buffer, len, ts->curFile);
+    }
+}
+
+/**\details
+ * Stops the child once maxErrors diagnostics have been counted
+ *
+ * Kill the child with SIGTERM and close the output pipe, so that anything
+ * the child started (like gcc's cc1) stops when it next writes rather than
+ * waiting on a pipe no one reads.
+ *
+ * \param ts (ThresherStruct with initialised values, truncated is set)
+ * \param table (the table counted so far)
+ * \param io (the pipes of the child)
+ *
+ * \return 1 if the child was stopped, otherwise 0
+ */
+static int stop_child(ThresherStruct *ts, int table[], ChildIO *io) {
+
+    int count = 0;
+
+    if (!ts->maxErrors) {
+        return 0;
+    }
+
+    for (int i = 0; i < NUM_CATEGORIES; ++i) {
+        if (ts->build->labels[i]) {
+            count += table[i];
+        }
+    }
+    if (count < ts->maxErrors) {
+        return 0;
+    }
+
+    kill(ts->pid, SIGTERM);
+    close(io->out.fd);
+    io->out.fd = -1;
+    ts->truncated = 1;
+
+    return 1;
+}
+
+/**\details
+ * Parses a JSON diagnostic into the table, for json_feed
+ *
+ * The diagnostic is classified by its kind, file and message. If show is
+ * enabled, or it is counted for --top, it is shown as gcc would print it:
+ * "file:line:column: kind: message [option]".
+ *
+ * \param context (the LineContext)
+ * \param diag (the diagnostic)
+ */
+static void parse_json_diag(void *context, JsonDiagnostic *diag) {
+
+    LineContext *lc = (LineContext *) context;
+    ThresherStruct *ts = lc->ts;
+    Buffer text = {NULL, 0, 0};
+    char number[64];
+    size_t location;
+    int category;
+
+    // gcc prints its JSON all at once, so the limit can be reached part of
+    // the way through a line
+    if (ts->truncated) {
+        return;
+    }
+
+    // Text outside the diagnostics (like the linker's) is an ordinary line
+    if (!diag->kind.len) {
+        parse_line(ts, lc->table, lc->io, diag->message.data,
+                diag->message.len);
+        stop_child(ts, lc->table, lc->io);
+        return;
+    }
+
+    category = rules_classify(ts->build, diag->kind.data, diag->file.data,
+            diag->message.data, diag->message.len, ts->curFile,
+            &lc->io->replies);
+    lc->table[category]++;
+
+    if (ts->show || (ts->top && ts->build->labels[category])) {
+        if (diag->file.len) {
+            buffer_append(&text, diag->file.data, diag->file.len);
+            sprintf(number, ":%ld:%ld", diag->line, diag->column);
+            buffer_append(&text, number, strlen(number));
+        }
+        location = text.len;
+        if (location) {
+            buffer_append(&text, ": ", 2);
+        }
+        buffer_append(&text, diag->kind.data, diag->kind.len);
+        buffer_append(&text, ": ", 2);
+        buffer_append(&text, diag->message.data, diag->message.len);
+        if (diag->option.len) {
+            buffer_append(&text, " [", 2);
+            buffer_append(&text, diag->option.data, diag->option.len);
+            buffer_append(&text, "]", 1);
+        }
+
+        if (ts->show) {
+            printf("%.*s\n", (int) text.len, text.data);
+        }
+        if (ts->top && ts->build->labels[category]) {
+            size_t start = location ? location + 2 : 0;
+
+            diag_add(&ts->diags, text.data + start, text.len - start,
+                    location ? text.data : ts->curFile,
+                    location ? location : strlen(ts->curFile), 1);
+        }
+        free(text.data);
+    }
+
+    stop_child(ts, lc->table, lc->io);
+}
+
+void parse_child(ThresherStruct *ts, int table[], ChildIO *io) {
     
+    LineContext context = {ts, table, io};
+    JsonStream stream;
     char *buffer;
+    size_t len;
 
     // Clear the table
     for (int i = 0; i < 6; ++i) {
         table[i] = 0;
     }
+    ts->truncated = 0;
+    ts->overCpu = 0;
 
-    // grab the line to be read from the readpipe and place it in the buffer
-    while (get_line(&buffer, readPipe)) {
-        // If show is enabled, print the buffer
-        if (ts->show) {
-            printf("%s\n", buffer);
+    // gcc's JSON is classified a diagnostic at a time
+    if (ts->jsonDiags && ts->build->json) {
+        json_init(&stream);
+        while (child_io_next(io, &buffer, &len) == 1) {
+            json_feed(&stream, buffer, len, parse_json_diag, &context);
+            if (ts->truncated) {
+                break;
+            }
         }
+        json_free(&stream);
+        return;
+    }
 
-        // Depending on the type, grab the parse value (corresponding to 
-        // an error entered on the table). Increase the value of the entry
-        // in the table.
-        switch (ts->type) {
-            case ANSIC:
-                table[c_parse(&buffer, ts->curFile, ts->type)]++;
-                break;
-            case CNN:
-                table[c_parse(&buffer, ts->curFile, ts->type)]++;
-                break;
-            case JAVA:
-                table[java_parse(&buffer, ts->curFile)]++;
-                break;
-            case LATEX:
-                table[latex_parse(&buffer, ts->curFile, writePipe)]++;
-                break;
+    // A compiler that never stops for a reply is left to finish, and then
+    // the log it wrote is counted all at once
+    if (ts->nonstop && ts->build->nonstop) {
+        char *path = rules_log_path(ts->build, ts->curFile);
+
+        while (child_io_next(io, &buffer, &len) == 1) {
+            if (ts->show) {
+                printf("%s\n", buffer);
+            }
+        }
+        log_count(ts, path, table);
+        free(path);
+        return;
+    }
+
+    // grab the line to be read from the child, buffer points into the
+    // reader so it is only valid until the next line is read
+    while (child_io_next(io, &buffer, &len) == 1) {
+        parse_line(ts, table, io, buffer, len);
+        if (stop_child(ts, table, io)) {
+            break;
         }
-        
-        // Free the buffer when done parsing
-        free(buffer);
     }
 }
 
-void parse_child_error(FILE *errPipe) {
+void parse_child_error(ChildIO *io) {
     
-    char *buffer;
-
     // Check if the child sent anything down the error pipe. If it is an
     // an error (exec/system failed), quit using this status.
-    while (get_line(&buffer, errPipe)) {
-        if (strstr(buffer, "3")) {
-            quit(ERR_EXEC, 1);
-        } else if (strstr(buffer, "4")) {
-            quit(ERR_SYS, 1);
+    buffer_append(&io->errors, "", 1);
+    if (strstr(io->errors.data, "3")) {
+        quit(ERR_EXEC, 1);
+    } else if (strstr(io->errors.data, "4")) {
+        quit(ERR_SYS, 1);
+    }
+}
+
+/**\details
+ * Works out why the child was stopped, if it was
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param table (int table of size 7, with the wait status)
+ * \param usage (the child's resource usage, or NULL if not known)
+ *
+ * \return the reason's index in stoppedReasons, or -1 if it ran to the end
+ */
+static int stopped_reason(ThresherStruct *ts, int table[],
+        struct rusage *usage) {
+
+    int signals[2];
+    long long used;
+
+    if (ts->truncated) {
+        return 0;
+    } else if (childTimedOut) {
+        return 1;
+    } else if (ts->serverDied) {
+        return 2;
+    }
+
+    if (!ts->cpuLimit) {
+        return -1;
+    }
+
+    // The kernel sends SIGXCPU at the limit and SIGKILL at the hard limit a
+    // second later. Anything (like the OOM killer) can send SIGKILL, so it
+    // only counts if the child's CPU time (which includes the programs it
+    // ran) reached the hard limit. The kernel checks the limit at each
+    // tick and the times it gives are scaled, so they can fall a little
+    // short of it.
+    signals[0] = ts->overCpu;
+    signals[1] = WIFSIGNALED(table[6]) ? WTERMSIG(table[6]) : 0;
+    used = usage ? (long long) (usage->ru_utime.tv_sec 
+            + usage->ru_stime.tv_sec) * 1000000 + usage->ru_utime.tv_usec
+            + usage->ru_stime.tv_usec : 0;
+
+    for (int i = 0; i < 2; ++i) {
+        if (signals[i] == SIGXCPU || (signals[i] == SIGKILL
+                && used + 100000 >= (ts->cpuLimit + 1) * 1000000LL)) {
+            return 3;
         }
+    }
 
-        free(buffer);
-    }   
+    return -1;
 }
 
-void build_table(ThresherStruct *ts, int table[]) {
+void build_table(ThresherStruct *ts, int table[], struct rusage *usage) {
 
-    // Build the table corresponding to the type
-    switch (ts->type) {
-        case ANSIC:
-            c_build_table(table, ts->curFile, ts->type);
-            break;
-        case CNN:
-            c_build_table(table, ts->curFile, ts->type);
-            break;
-        case JAVA:
-            java_build_table(table, ts->curFile);
-            break;
-        case LATEX:
-            latex_build_table(table, ts->curFile);
-            break;
-    }  
+    int reason = stopped_reason(ts, table, usage);
+
+    // A worker tells the pool its compiler was stopped, so the run is not
+    // kept as the file's result
+    int stopped = ts->worker ? ERR_STOPPED : ERR_NONZERO;
+
+    if (outputFormat != FORMAT_TEXT) {
+        report_record(ts->build, table, ts->curFile, usage, 
+                report_now() - ts->started, 
+                reason == -1 ? NULL : stoppedReasons[reason][1]);
+        if (reason != -1) {
+            quit(stopped, 0);
+        } else if (WEXITSTATUS(table[6]) != 0) {
+            quit(ERR_NONZERO, 0);
+        }
+        return;
+    }
+
+    // A compiler that was stopped has no exit status worth giving
+    if (reason != -1) {
+        rules_print_table(ts->build, table);
+        printf("%s %s\n", ts->curFile, stoppedReasons[reason][0]);
+        quit(stopped, 1);
+    }
+
+    // Build the table with the labels of the build type
+    rules_build_table(ts->build, table, ts->curFile);
 }
 
 void sigint_recieved(int s) {
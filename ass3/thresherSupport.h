@@ -9,10 +9,11 @@
  * All commenting is designed to be compatible with Doxygen.
  */
 
-#include "ansiC.h"
-#include "java.h"
-#include "latex.h"
-#include "misc.h"
+#ifndef THRESHER_SUPPORT_H
+#define THRESHER_SUPPORT_H
+
+#include "diag.h"
+#include "report.h"
 
 /** \struct ThresherStruct
  *  \brief Creates a structure that values for thresher that have to be
@@ -22,41 +23,142 @@ typedef struct {
     int childOutput[2];     /**< File descript for child output  */
     int childInput[2];      /**< File descript for child input  */
     int childError[2];      /**< File descript for child error  */
+    int childOther[2];      /**< File descript for child's other stream */
     pid_t pid;              /**< Pid of the process (0 for child) */
     int type;               /**< Type of the program */
+    BuildType *build;       /**< The build type of the program */
     char *curFile;          /**< String for the current file */
     char *cmd;              /**< String for the command to compile with */
     int show;               /**< Boolean for show enabled */
+    int jobs;               /**< The number of files to run at once */
+    char **logs;            /**< Compiler logs to read instead, or NULL */
+    int numLogs;            /**< The number of logs */
+    int useFork;            /**< Boolean for fork and exec over posix_spawn */
+    int watch;              /**< Boolean for watching the files */
+    double started;         /**< When the compiler was started, in ms */
+    int top;                /**< The most common diagnostics to print, or 0 */
+    DiagTable diags;        /**< The diagnostics counted for --top */
+    int diagFd;             /**< Pipe a worker sends its diagnostics down */
+    char *cacheDir;         /**< Directory of the result cache, or NULL */
+    long cacheSize;         /**< The most bytes the cache may hold */
+    int batch;              /**< The most files to give each compiler run */
+    char **batchFiles;      /**< The files of the batch being run */
+    int batchSize;          /**< The number of batchFiles, 0 if no batch */
+    int jsonDiags;          /**< Boolean for reading JSON diagnostics */
+    int syntaxOnly;         /**< Boolean for only checking syntax */
+    int verify;             /**< Boolean for comparing with syntax only */
+    int nonstop;            /**< Boolean for counting logs, not replying */
+    int server;             /**< Boolean for one compile server per run */
+    int serverDied;         /**< Boolean for the server ending unanswered */
+    char *serverSource;     /**< Path of the server's source, or NULL */
+    int maxErrors;          /**< Diagnostics that stop the compiler, or 0 */
+    int truncated;          /**< Boolean for the compiler being stopped */
+    char *history;          /**< File of past compile times, or NULL */
+    int timeout;            /**< Seconds a compiler may run for, or 0 */
+    int cpuLimit;           /**< Seconds of CPU a compiler may use, or 0 */
+    int memLimit;           /**< MB of memory a compiler may map, or 0 */
+    int overCpu;            /**< Signal a driver said killed a program */
+    int worker;             /**< Boolean for being a pool worker */
 } ThresherStruct;
 
-pid_t childPid; //!< Global var. Stores child's pid if exists, otherwise 0.
+/** \struct ChildIO
+ *  \brief The parent's ends of a child's pipes, none of which block
+ */
+typedef struct {
+    LineReader out;         /**< The build type's output stream */
+    int err;                /**< The error pipe, -1 once closed */
+    int other;              /**< The child's other output stream, or -1 */
+    int in;                 /**< The child's stdin, -1 once closed */
+    FILE *forward;          /**< Where the other stream is printed */
+    Buffer errors;          /**< What was sent down the error pipe */
+    Buffer replies;         /**< Replies not yet written to the child */
+} ChildIO;
+
+//! Global var. Stores child's pid if exists, otherwise 0.
+extern pid_t childPid;
 
 /**\details
  * Handle threshers arguments. 
  *
- * Set the show value if "--show" has been given, check if the minimum number
- * of arguments have been given. If the minimum arguments have not been given,
- * quit, otherwise set the type value. If an invalid type is given, quit.
+ * Load the built in build types, then read the options given before type,
+ * setting:
  *
- * If any errors are encountered they are sent down the error pipe to the 
- * parent and the child will quit.
+ * - show for "--show", useFork for "--fork" and watch for "--watch"
+ * - outputFormat for "--format json|csv"
+ * - jobs for "-j jobs" (0 otherwise)
+ * - the build types from each "--rules file", and logs from each 
+ *   "--log file"
+ * - cacheDir for "--cache dir" and cacheSize (in MB) for 
+ *   "--cache-size size"
+ * - top for "--top num" and batch for "--batch num"
+ * - jsonDiags for "--json-diagnostics", syntaxOnly for "--syntax-only"
+ *   and verify for "--verify-syntax"
+ * - nonstop for "--nonstop" and server for "--server"
+ * - maxErrors for "--max-errors num" (1 for "--fail-fast")
+ * - history for "--history file"
+ * - timeout, cpuLimit and memLimit for "--timeout secs", 
+ *   "--cpu-limit secs" and "--mem-limit MB" (a limit turns on useFork, as
+ *   posix_spawn cannot set the compiler's limits)
+ *
+ * Quit with ERR_USAGE if too few arguments are left (there is no command
+ * with logs) or if options that can't be used together were given (see
+ * bad_options), and with ERR_SYS if cacheDir can't be made (cache_init).
+ * Compile the build types, then set the type, build and cmd
+ * values, quitting if the type is invalid. A nonstop run with -j whose
+ * files would write the same log quits with ERR_USAGE too.
  *
  * \param argc (int of the number of arguments)
  * \param argv (string array containing the arguments)
- * \param show (int that shows whether show is enabled, value is modified 
- * by the function)
+ * \param ts (ThresherStruct to set the show, jobs, type, build and cmd 
+ * values of, value is modified by the function)
  * 
- * \return type (int describing what type thresher is running)
+ * \return the index in argv of the first filename
  */
-int arg_handler(int argc, char** argv, int *show);
+int arg_handler(int argc, char** argv, ThresherStruct *ts);
+
+/**\details
+ * Summarises the compiler output for ts->curFile. 
+ *
+ * Create the pipes, throwing an error if the system call fails, then take
+ * a job token (token_acquire) and start the compiler with posix_spawn 
+ * (spawn_child), which does not copy thresher's address space. If the
+ * useFork value is set, fork instead and the child becomes the compiler 
+ * (create_child). If timeout is set, the compiler is started in its own
+ * process group and the whole group is killed with SIGKILL if it is still
+ * running after timeout seconds. The parent parses its output and prints
+ * the table 
+ * (create_parent), or a table for each file if ts->batchSize files are 
+ * being run at once (batch_parent).
+ *
+ * \param childPid global variable used (set to the pid of the child)
+ * \param ts (ThresherStruct with initialised values)
+ */
+void thresh_file(ThresherStruct *ts);
+
+/**\details
+ * Starts the compiler with posix_spawn, on the batch of files if there is
+ * one. 
+ * 
+ * Set up the same pipes as create_child would as file actions, and spawn
+ * the build type's command. The child cannot report errors down the error
+ * pipe, so if the spawn fails, print the lines create_parent would have and
+ * quit with ERR_EXEC.
+ *
+ * \param childPid global variable used (set to the pid of the child)
+ * \param ts (ThresherStruct with initialised values, pid is set)
+ */
+void spawn_child(ThresherStruct *ts);
 
 /**\details
  * Creates the child process. 
  * 
- * Sets up an error pipe, an input pipe and an 
- * output pipe, with the input pipe replacing stdin and the output pipe
- * replacing stdout. Close the unused ends of the pipe. If this was 
- * successful, exec the required process. If exec fails, quit.
+ * Sets up an error pipe, an input pipe, an output pipe and an other pipe,
+ * with the input pipe replacing stdin, the output pipe replacing the build
+ * type's output stream and the other pipe replacing the other stream. 
+ * Close the unused ends of the pipe. Start a new process group if timeout
+ * is set, and limit the CPU seconds (RLIMIT_CPU) and address space 
+ * (RLIMIT_AS) if cpuLimit and memLimit are set. If this was successful,
+ * exec the build type's command. If exec fails, quit.
  *
  * If any errors are encountered they are sent down the error pipe to the 
  * parent and the child will quit.
@@ -68,10 +170,11 @@ void create_child(ThresherStruct *ts);
 /**\details
  * Creates the parent process. 
  * 
- * Set up the error, input and output pipes so
- * that the parent can read from the child, then parse the output given by
- * the child. Once the output has been parsed, parse the error pipe to see
- * if the program encounted any errors. Finally, build the table and close
+ * Set up the error, input, output and other pipes so that the parent can
+ * read from the child without blocking (child_io_init), then parse the 
+ * output given by the child. Once the output has been parsed and the other
+ * pipes closed, parse the error pipe to see if the program encounted any
+ * errors. Finally, build the table and close
  * the pipes.
  *
  * If any errors are encountered or the child passed errors down the error
@@ -82,42 +185,114 @@ void create_child(ThresherStruct *ts);
  */
 void create_parent(ThresherStruct *ts);
 
+/**\details
+ * Sets up the parent's ends of the child's pipes. 
+ *
+ * Close the child's ends of the pipes and make the parent's ends 
+ * non-blocking. The child's other stream (stdout for stderr build types,
+ * stderr for stdout ones) is printed to the same stream of thresher, or to
+ * stderr if that would mix it into records.
+ *
+ * \param ts (ThresherStruct with the pipes created)
+ * \param io (the pipes to set up, value is modified)
+ */
+void child_io_init(ThresherStruct *ts, ChildIO *io);
+
+/**\details
+ * Gets the next line of the child's output. 
+ *
+ * Write any replies waiting for the child, then read a line. While no
+ * line is ready, poll every pipe at once: write replies as the child reads
+ * them, read the error pipe and print the other stream, so that the child
+ * never stops on a full pipe that thresher is not reading.
+ *
+ * \param io (the pipes set up by child_io_init)
+ * \param buffer (set to the line, only valid until the next call)
+ * \param len (set to the length of the line)
+ *
+ * \return 1 if a line was read, 0 at the end of the output
+ */
+int child_io_next(ChildIO *io, char **buffer, size_t *len);
+
+/**\details
+ * Reads the error pipe and the other stream until the child closes them,
+ * and drops any replies that were not needed.
+ *
+ * \param io (the pipes set up by child_io_init)
+ */
+void child_io_finish(ChildIO *io);
+
+/**\details
+ * Closes the pipes and frees the memory used by them.
+ *
+ * \param io (the pipes set up by child_io_init)
+ */
+void child_io_free(ChildIO *io);
+
+/**\details
+ * Runs the compiler on ts->curFile and counts its output, printing 
+ * nothing.
+ *
+ * As thresh_file, but with spawn_child, and the table (with the exit 
+ * status in table[6]) is given back rather than printed.
+ *
+ * \param ts (ThresherStruct with initialised values, show must be 0)
+ * \param table (int table of size 7, value is modified by the function)
+ */
+void run_child(ThresherStruct *ts, int table[]);
+
 /**\details
  * Parses the output given by the child. 
  * 
- * Create a loop that will read the childs output into a buffer while the 
- * child is still sending data. If show is true output the buffer, then 
- * call the parse function relevant to thresher's type of and increase 
- * the table value that it returns. Finally, free the buffer.
+ * Read the childs output a line at a time (child_io_next) while the child
+ * is still sending data. If jsonDiags is set and the build type has a json
+ * template, make a line from each JSON diagnostic (json_feed) instead. If
+ * nonstop is set and the build type has a nonstop template, the output is
+ * only read (and shown), and the log the compiler wrote is counted once it
+ * has finished (log_count). 
+ * If show is true output the line, then parse it under the rules of 
+ * thresher's build type and increase the table value that it returns. If 
+ * top is set, count lines in a labelled category in the diags table.
+ *
+ * If maxErrors is set, stop as soon as that many lines are in labelled
+ * categories: kill the child with SIGTERM, as sigint_recieved does, stop
+ * reading its output and set truncated.
  *
  * \param ts (ThresherStruct with initialised values)
  * \param table (int table of size 7, value is modified by the function)
- * \param writePipe (file pointer that passes data to the child)
- * \param readPipe (file pointer that passes data from the child)
+ * \param io (the pipes of the child)
  */
-void parse_child(ThresherStruct *ts, int table[], 
-        FILE *writePipe, FILE *readPipe);
+void parse_child(ThresherStruct *ts, int table[], ChildIO *io);
 
 /**\details
  * Parses the error pipe from the child. 
  * 
- * Create a loop that will read the childs error pipe into a buffer while
- * the child is still sending data. If a relevant error message is recieved, 
- * quit the parent with the relevant status.
+ * If a relevant error message was recieved down the error pipe, quit the
+ * parent with the relevant status.
  *
- * \param errPipe (file pointer that passes error data from the child)
+ * \param io (the pipes of the child, after child_io_finish)
  */
-void parse_child_error(FILE *errPipe);
+void parse_child_error(ChildIO *io);
 
 /**\details
  * Builds the table that shows what errors were encountered. 
  * 
- * Call the relevant build function relevant to thresher's type. 
+ * Print the table using the labels of thresher's build type. If 
+ * outputFormat is not FORMAT_TEXT, print the file's record instead 
+ * (report_record), quitting with ERR_NONZERO afterwards if the child 
+ * exited with a non-zero status. If the child was stopped early 
+ * (truncated), was killed at the timeout, went unanswered by the compile
+ * server (serverDied) or was killed at the CPU limit (by SIGXCPU, or
+ * overCpu for a program it ran like gcc's cc1, or by SIGKILL once usage
+ * shows the hard limit was reached), say so in place of its exit status
+ * (or in the record's stopped field) and quit with ERR_NONZERO, as the
+ * file is bad.
  *
  * \param ts (ThresherStruct with initialised values)
  * \param table (int table of size 7)
+ * \param usage (the child's resource usage)
  */
-void build_table(ThresherStruct *ts, int table[]);
+void build_table(ThresherStruct *ts, int table[], struct rusage *usage);
 
 /**\details
  * Handles threshers response to SIGINT
@@ -127,4 +302,6 @@ void build_table(ThresherStruct *ts, int table[]);
  * \param childPid global variable used
  * \param s (The signal number that cauased the function to be called)
  */
-void sigint_recieved(int s);
\ No newline at end of file
+void sigint_recieved(int s);
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * \file   verify.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the check of thresher's syntax only mode
+ *
+ * \details
+ *
+ * Contains the functions that run a corpus of files with and without
+ * --syntax-only and report any file whose table changes.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include "verify.h"
+
+/**\details
+ * Prints one of a file's tables and its exit status
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param name (what the table is from)
+ * \param table (the table, with the exit status in table[6])
+ */
+static void print_run(ThresherStruct *ts, const char *name, int table[]) {
+
+    printf("%s:\n", name);
+    rules_print_table(ts->build, table);
+    if (WIFEXITED(table[6])) {
+        printf("exited with status %d\n", WEXITSTATUS(table[6]));
+    } else {
+        printf("did not exit normally\n");
+    }
+}
+
+void verify_run(ThresherStruct *ts, char **files, int numFiles) {
+
+    int full[7], syntax[7], differ = 0, same;
+
+    if (!ts->build->syntax) {
+        printf("%s has no syntax only arguments\n", ts->build->name);
+        return;
+    }
+
+    for (int i = 0; i < numFiles; ++i) {
+        ts->curFile = files[i];
+
+        ts->syntaxOnly = 0;
+        run_child(ts, full);
+        ts->syntaxOnly = 1;
+        run_child(ts, syntax);
+
+        // Every category counts, labelled or not, as does the status
+        same = !memcmp(full, syntax, sizeof(full));
+        printf("----\n%s %s\n", files[i], same ? "matches" : "differs");
+        if (!same) {
+            print_run(ts, "full compile", full);
+            print_run(ts, "syntax only", syntax);
+            differ++;
+        }
+    }
+
+    printf("----\n%d of %d files differ\n----\n", differ, numFiles);
+    if (differ) {
+        quit(ERR_NONZERO, 0);
+    }
+}
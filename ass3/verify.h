@@ -0,0 +1,31 @@
+/**
+ * \file   verify.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for verify.c
+ *
+ * \details
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "thresherSupport.h"
+
+/**\details
+ * Checks that --syntax-only gives the same tables as a full compile.
+ *
+ * Run the compiler on each file twice, once as usual and once only
+ * checking syntax, and compare the tables and exit statuses. Print whether
+ * each file matches, with both tables if it does not, then how many files
+ * differ. Quit with ERR_NONZERO if any do.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param files (string array of the files to check)
+ * \param numFiles (the number of files)
+ */
+void verify_run(ThresherStruct *ts, char **files, int numFiles);
+
+#endif
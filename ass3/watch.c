@@ -0,0 +1,214 @@
+/**
+ * \file   watch.c
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  Contains the watch mode of thresher
+ *
+ * \details
+ *
+ * Contains the functions that keep thresher running, rerunning only the
+ * files that change and keeping the output of the rest in memory.
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#include <sys/inotify.h>
+
+#include "watch.h"
+#include "cache.h"
+
+/**\details
+ * Reads the waiting inotify events and marks the files they are about
+ *
+ * \param fd (the inotify file descriptor)
+ * \param watched (the watch of every file, dirty values are set)
+ * \param numFiles (the number of files)
+ *
+ * \return the number of events about the files
+ */
+static int read_events(int fd, WatchFile *watched, int numFiles) {
+
+    char buffer[4096]
+            __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t count;
+    int found = 0;
+
+    if ((count = read(fd, buffer, sizeof(buffer))) <= 0) {
+        if (count == -1 && errno == EINTR) {
+            return 0;
+        }
+        quit(ERR_SYS, 0);
+    }
+
+    for (char *p = buffer; p < buffer + count;
+            p += sizeof(struct inotify_event) + event->len) {
+        event = (const struct inotify_event *) p;
+        if (!event->len) {
+            continue;
+        }
+        for (int i = 0; i < numFiles; ++i) {
+            if (watched[i].wd == event->wd
+                    && !strcmp(watched[i].name, event->name)) {
+                watched[i].dirty = 1;
+                found++;
+            }
+        }
+    }
+
+    return found;
+}
+
+void watch_run(ThresherStruct *ts, char **files, int numFiles) {
+
+    JobStruct *jobs = (JobStruct *) calloc(numFiles, sizeof(JobStruct));
+    WatchFile *watched = (WatchFile *) calloc(numFiles, sizeof(WatchFile));
+    struct pollfd fds;
+    struct sigaction sa;
+    int fd, ready, changed;
+
+    if ((fd = inotify_init1(IN_CLOEXEC)) == -1) {
+        quit(ERR_SYS, 0);
+    }
+
+    // Watch the directory of each file, as editors often save by renaming
+    // a new file over the old one
+    for (int i = 0; i < numFiles; ++i) {
+        char *slash = strrchr(files[i], '/');
+        char *dir = slash ? strndup(files[i], slash - files[i]) : NULL;
+
+        watched[i].wd = inotify_add_watch(fd,
+                dir ? (*dir ? dir : "/") : ".",
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watched[i].wd == -1) {
+            quit(ERR_SYS, 0);
+        }
+        watched[i].name = slash ? slash + 1 : files[i];
+        watched[i].dirty = 1;
+        free(dir);
+
+        jobs[i].file = files[i];
+        jobs[i].out = -1;
+        jobs[i].err = -1;
+        jobs[i].diag = -1;
+    }
+
+    // Kill the workers rather than a single child on SIGINT
+    pool_track(jobs, numFiles);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = pool_sigint_recieved;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &sa, 0);
+
+    fds.fd = fd;
+    fds.events = POLLIN;
+
+    while (1) {
+        // Print every file, rerun or not, in the order they were given, if
+        // any of them were rerun
+        if (watch_update(ts, jobs, watched, numFiles)) {
+            report_header(ts->build);
+            for (int i = 0; i < numFiles; ++i) {
+                fwrite(jobs[i].outBuf.data, 1, jobs[i].outBuf.len, stdout);
+                fflush(stdout);
+                fwrite(jobs[i].errBuf.data, 1, jobs[i].errBuf.len, stderr);
+            }
+        }
+
+        // Wait for one of the files to change (other files in the same
+        // directories change too), then until nothing has changed for a 
+        // while so a burst of saves is only run once
+        changed = 0;
+        while (!changed) {
+            if ((ready = poll(&fds, 1, -1)) == -1 && errno != EINTR) {
+                quit(ERR_SYS, 0);
+            }
+            if (ready > 0) {
+                changed = read_events(fd, watched, numFiles);
+            }
+        }
+        while ((ready = poll(&fds, 1, WATCH_DEBOUNCE_MS)) > 0
+                || (ready == -1 && errno == EINTR)) {
+            if (ready > 0) {
+                read_events(fd, watched, numFiles);
+            }
+        }
+    }
+}
+
+int watch_update(ThresherStruct *ts, JobStruct *jobs, WatchFile *watched,
+        int numFiles) {
+
+    int maxJobs = ts->jobs > 1 ? ts->jobs : 1;
+    int next = 0, running = 0, updated = 0, numFds;
+    struct pollfd *fds = (struct pollfd *) malloc(sizeof(struct pollfd)
+            * 2 * maxJobs);
+    JobStruct **owner = (JobStruct **) malloc(sizeof(JobStruct *)
+            * 2 * maxJobs);
+    char key[CACHE_KEY_LEN + 1];
+
+    while (next < numFiles || running) {
+
+        // Keep up to ts->jobs workers running on the dirty files
+        while (running < maxJobs && next < numFiles) {
+            JobStruct *job = &jobs[next];
+
+            if (!watched[next++].dirty) {
+                continue;
+            }
+            watched[next - 1].dirty = 0;
+
+            // Saving a file without changing it doesn't need a new run
+            strcpy(key, job->key);
+            cache_key(ts, job);
+            if (job->done && job->key[0] && !strcmp(key, job->key)) {
+                continue;
+            }
+
+            free(job->outBuf.data);
+            free(job->errBuf.data);
+            memset(&job->outBuf, 0, sizeof(Buffer));
+            memset(&job->errBuf, 0, sizeof(Buffer));
+            job->done = 0;
+            updated++;
+
+            if (ts->cacheDir && cache_lookup(ts, job)) {
+                continue;
+            }
+            start_job(ts, jobs, numFiles, job);
+            running++;
+        }
+
+        // Wait for any of the running workers to send something
+        numFds = 0;
+        for (int i = 0; i < next; ++i) {
+            if (jobs[i].out != -1) {
+                owner[numFds] = &jobs[i];
+                fds[numFds].fd = jobs[i].out;
+                fds[numFds++].events = POLLIN;
+            }
+            if (jobs[i].err != -1) {
+                owner[numFds] = &jobs[i];
+                fds[numFds].fd = jobs[i].err;
+                fds[numFds++].events = POLLIN;
+            }
+        }
+
+        if (numFds && poll(fds, numFds, -1) == -1 && errno != EINTR) {
+            quit(ERR_SYS, 0);
+        }
+
+        for (int i = 0; i < numFds; ++i) {
+            if (fds[i].revents && read_job(owner[i], fds[i].fd)) {
+                if (ts->cacheDir) {
+                    cache_store(ts, owner[i]);
+                }
+                running--;
+            }
+        }
+    }
+
+    free(owner);
+    free(fds);
+    return updated;
+}
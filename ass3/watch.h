@@ -0,0 +1,61 @@
+/**
+ * \file   watch.h
+ * \author Merrick Heley (merrick.heley@uqconnect.edu.au)
+ * \version 1.0
+ * \brief  header file for watch.c
+ *
+ * \details
+ *
+ * All commenting is designed to be compatible with Doxygen.
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "pool.h"
+
+#define WATCH_DEBOUNCE_MS 100
+
+/** \struct WatchFile
+ *  \brief Where a watched file is, so inotify events can be matched to it
+ */
+typedef struct {
+    int wd;                 /**< The watch on the file's directory */
+    char *name;             /**< The file's name within its directory */
+    int dirty;              /**< Boolean for the file needing a new run */
+} WatchFile;
+
+/**\details
+ * Summarises the files, then keeps summarising them as they change.
+ *
+ * Watch the directory of every file with inotify (editors often replace a
+ * file rather than write to it). Run every file through a worker, as the
+ * pool does, keeping each file's output in memory, and print them all in
+ * order. Then wait for changes: once a file changes, wait until nothing
+ * has changed for WATCH_DEBOUNCE_MS, rerun only the changed files whose
+ * contents are different and, if any were, print every file's output 
+ * again, using the kept output for the files that were not rerun. A file
+ * exiting with a non-zero status does not stop the watch; SIGINT does.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param files (string array of the files to summarise)
+ * \param numFiles (the number of files)
+ */
+void watch_run(ThresherStruct *ts, char **files, int numFiles);
+
+/**\details
+ * Runs the dirty files, up to ts->jobs at a time, and keeps their output.
+ *
+ * A file whose cache key is the same as when it last ran is not run again.
+ *
+ * \param ts (ThresherStruct with initialised values)
+ * \param jobs (the job of every file, the dirty ones are modified)
+ * \param watched (the watch of every file, dirty values are cleared)
+ * \param numFiles (the number of files)
+ *
+ * \return the number of files with new output
+ */
+int watch_update(ThresherStruct *ts, JobStruct *jobs, WatchFile *watched,
+        int numFiles);
+
+#endif